@@ -1,6 +1,12 @@
 #include "BeatNet.h"
+#include "rtlog.h"
 #include <filesystem>
+#include <cstdio>
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 bool BeatNet::loadONNXRuntime(const std::string& dynamicLibName) {
     
@@ -45,12 +51,20 @@ bool BeatNet::loadONNXRuntime(const std::string& dynamicLibName) {
     CreateEnv = ort->CreateEnv;
     CreateSessionOptions = ort->CreateSessionOptions;
     SetIntraOpNumThreads = ort->SetIntraOpNumThreads;
+    SetInterOpNumThreads = ort->SetInterOpNumThreads;
+    SetSessionExecutionMode = ort->SetSessionExecutionMode;
+    AddSessionConfigEntry = ort->AddSessionConfigEntry;
+    SessionOptionsSetCustomCreateThreadFn = ort->SessionOptionsSetCustomCreateThreadFn;
+    SessionOptionsSetCustomThreadCreationOptions = ort->SessionOptionsSetCustomThreadCreationOptions;
+    SessionOptionsSetCustomJoinThreadFn = ort->SessionOptionsSetCustomJoinThreadFn;
     CreateRunOptions = ort->CreateRunOptions;
     CreateCpuMemoryInfo = ort->CreateCpuMemoryInfo;
     GetAllocatorWithDefaultOptions = ort->GetAllocatorWithDefaultOptions;
     CreateSession = ort->CreateSession;
     SessionGetInputName = ort->SessionGetInputName;
     SessionGetOutputName = ort->SessionGetOutputName;
+    SessionGetInputCount = ort->SessionGetInputCount;
+    SessionGetOutputCount = ort->SessionGetOutputCount;
     AllocatorFree = ort->AllocatorFree;
     ReleaseSession = ort->ReleaseSession;
     ReleaseSessionOptions = ort->ReleaseSessionOptions;
@@ -61,20 +75,59 @@ bool BeatNet::loadONNXRuntime(const std::string& dynamicLibName) {
     return true;
 }
 
+namespace {
+    // ORT threads are started through these when the session has a placement for them
+    OrtCustomThreadHandle createPlacedThread(void* options, OrtThreadWorkerFn work, void* param)
+    {
+        const ThreadPlacement* placement = static_cast<const ThreadPlacement*>(options);
+        std::thread* thread = new std::thread([placement, work, param] {
+            applyThreadPlacement(*placement);
+            work(param);
+        });
+        return reinterpret_cast<OrtCustomThreadHandle>(thread);
+    }
+
+    void joinPlacedThread(OrtCustomThreadHandle handle)
+    {
+        std::thread* thread = reinterpret_cast<std::thread*>(const_cast<OrtCustomHandleType*>(handle));
+        thread->join();
+        delete thread;
+    }
+
+    ThreadConfig intraOpConfig(int intraopnumthreads)
+    {
+        ThreadConfig config;
+        config.intra_op_threads = intraopnumthreads;
+        return config;
+    }
+}
+
 BeatNet::BeatNet(
     std::string modelPath,
     const char* ortenvname,
     OrtLoggingLevel ortlogginglevel,
     int intraopnumthreads
+):
+    BeatNet(std::move(modelPath), intraOpConfig(intraopnumthreads), ortenvname, ortlogginglevel)
+{
+}
+
+BeatNet::BeatNet(
+    std::string modelPath,
+    const ThreadConfig& threadConfig,
+    const char* ortenvname,
+    OrtLoggingLevel ortlogginglevel
 ): 
-    env(nullptr), session(nullptr), session_options(nullptr),
-    memory_info(nullptr), allocator(nullptr), run_options(nullptr),
-    input_name(nullptr), output_name(nullptr),
-    signal_processor(FRAME_LENGTH, HOP_SIZE),
-    fft_processor(FRAME_LENGTH, FFT_SIZE, FRAME_SIZE_POW2),
-    filterbank_processor(BANKS_PER_OCTAVE, FFT_SIZE, SR_BEATNET, 30.0f, 11025.0f, true, true),
-    SR(0),bufferSize(0)
+    active_state(nullptr), pending_state(nullptr), retired_states(nullptr), configured_state(nullptr),
+    env(nullptr), session_options(nullptr), session(nullptr),
+    allocator(nullptr), memory_info(nullptr), run_options(nullptr),
+    input_name(nullptr), output_name(nullptr), thread_config(threadConfig),
+    arena(sizeof(StreamBuffers)), buffers(*arena.create<StreamBuffers>()),
+    feature_pipeline(buffers.feature_pipeline), preprocessed_input(buffers.preprocessed_input),
+    model_latency(MS_MODEL_LATENCY),
+    block_start_time(0.0), block_end_time(0.0)
 {
+    RTLog::start();
 
     if (!loadONNXRuntime("onnxruntime")) {
         throw std::runtime_error("Failed to load ONNX Runtime dynamically.");
@@ -85,9 +138,21 @@ BeatNet::BeatNet(
     if ( !std::filesystem::exists(modelPath)) {
         throw std::runtime_error("Model path does not exist: " + modelPath);}
 
-    CreateEnv(ORT_LOGGING_LEVEL_WARNING, "BeatNet", &env);
+    CreateEnv(ortlogginglevel, ortenvname, &env);
     CreateSessionOptions(&session_options);
-    SetIntraOpNumThreads(session_options, 1);
+    SetIntraOpNumThreads(session_options, std::max(1, thread_config.intra_op_threads));
+    if (thread_config.inter_op_threads > 1) {
+        SetSessionExecutionMode(session_options, ORT_PARALLEL);
+        SetInterOpNumThreads(session_options, thread_config.inter_op_threads);
+    }
+    const char* spinning = thread_config.allow_spinning ? "1" : "0";
+    AddSessionConfigEntry(session_options, "session.intra_op.allow_spinning", spinning);
+    AddSessionConfigEntry(session_options, "session.inter_op.allow_spinning", spinning);
+    if (!thread_config.inference.isDefault()) {
+        SessionOptionsSetCustomCreateThreadFn(session_options, createPlacedThread);
+        SessionOptionsSetCustomThreadCreationOptions(session_options, &thread_config.inference);
+        SessionOptionsSetCustomJoinThreadFn(session_options, joinPlacedThread);
+    }
     CreateRunOptions(&run_options);
     CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info);
     GetAllocatorWithDefaultOptions(&allocator);
@@ -102,18 +167,37 @@ BeatNet::BeatNet(
     SessionGetInputName(session, 0, allocator, const_cast<char**>(&this->input_name));
     SessionGetOutputName(session, 0, allocator, const_cast<char**>(&this->output_name));
 
-    preprocessed_input.resize(FBANK_SIZE);
-    log_fb.resize(FBANK_SIZE / 2);
-    diff.resize(FBANK_SIZE / 2);
-    filters.resize(FBANK_SIZE / 2);
-    spectrum.resize(FFT_SIZE);
-    input_shape = {1, 1, FBANK_SIZE};
+    // models exported with the LSTM state as inputs 1, 2 (h0, c0) and outputs 1, 2 (hn, cn) carry it between Run calls
+    size_t input_count = 0, output_count = 0;
+    SessionGetInputCount(session, &input_count);
+    SessionGetOutputCount(session, &output_count);
+    stateful_model = input_count == 3 && output_count == 3;
+    if (stateful_model) {
+        for (int i = 0; i < 2; ++i) {
+            SessionGetInputName(session, i + 1, allocator, const_cast<char**>(&state_input_names[i]));
+            SessionGetOutputName(session, i + 1, allocator, const_cast<char**>(&state_output_names[i]));
+        }
+    }
+
+    block_events.reserve(16);
+    pending_hops.reserve(MAX_BATCH_HOPS);
+    createTensors();
+    initSilence();
 }
 
 BeatNet::~BeatNet()
 {
+    reclaimStates();
+    delete pending_state.exchange(nullptr);
+    delete active_state;
+
+    releaseTensors();
     if (input_name) AllocatorFree(allocator, const_cast<char*>(input_name));
     if (output_name) AllocatorFree(allocator, const_cast<char*>(output_name));
+    for (int i = 0; i < 2; ++i) {
+        if (state_input_names[i]) AllocatorFree(allocator, const_cast<char*>(state_input_names[i]));
+        if (state_output_names[i]) AllocatorFree(allocator, const_cast<char*>(state_output_names[i]));
+    }
     if (session) ReleaseSession(session);
     if (session_options) ReleaseSessionOptions(session_options);
     if (memory_info) ReleaseMemoryInfo(memory_info);
@@ -128,73 +212,535 @@ BeatNet::~BeatNet()
 }
 
 
-void BeatNet::setup(double sampleRate, int samplesPerBlock) {
-    SR = sampleRate;
-    bufferSize = samplesPerBlock;
-    resampler.setup(SR, SR_BEATNET, bufferSize);
+BeatNet::StreamState::StreamState(double sampleRate, int samplesPerBlock):
+    sample_rate(sampleRate),
+    block_size(samplesPerBlock),
+    resampler(sampleRate, SR_BEATNET, samplesPerBlock),
+    start_time(0.0),
+    samples_processed(0),
+    next_retired(nullptr)
+{
 }
 
-bool BeatNet::preprocess(const std::vector<float>& raw_input, std::vector<float>& preprocessed_input) {
-        
-    std::vector<float> resampled = resampler.resample(raw_input);
-    std::vector<float> frame;
-    bool valid_frame = signal_processor.process(resampled,frame);
-    if (!valid_frame) {
-        // std::cout<<"invalid frame and will be invalid for the first ~"<<FRAME_LENGTH/resampled.size()-1<<" frames"<<std::endl;
+bool BeatNet::setup(double sampleRate, int samplesPerBlock) {
+    if (sampleRate <= 0 || samplesPerBlock <= 0) {
+        std::cerr << "Invalid configuration: " << sampleRate << " Hz, " << samplesPerBlock << " samples per block" << std::endl;
         return false;
     }
-        
-    spectrum = fft_processor.compute_fft(frame);
-    filters = filterbank_processor.apply(spectrum);
-    log_fb = log_compress(filters);
-    diff = spectral_diff(log_fb, prev_log_fb);
-    hstack(log_fb, diff, preprocessed_input);
+
+    // all allocations and library loading happen here, on the caller's thread
+    StreamState* state = new StreamState(sampleRate, samplesPerBlock);
+    if (!state->resampler.isValid()) {
+        delete state;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(setup_mutex);
+    reclaimStates();
+    configured_state = state;
+    // a state that was still pending has never been seen by the audio thread, so it can be freed right away
+    delete pending_state.exchange(state, std::memory_order_acq_rel);
     return true;
 }
 
+void BeatNet::retireState(StreamState* state) {
+    // called on the audio thread, the actual delete happens in the next setup() call
+    state->next_retired = retired_states.load(std::memory_order_relaxed);
+    while (!retired_states.compare_exchange_weak(state->next_retired, state,
+                                                 std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+void BeatNet::reclaimStates() {
+    StreamState* state = retired_states.exchange(nullptr, std::memory_order_acquire);
+    while (state) {
+        StreamState* next = state->next_retired;
+        delete state;
+        state = next;
+    }
+}
+
 bool BeatNet::process(const std::vector<float>& raw_input, std::vector<float>& output) {
-    if (!preprocess(raw_input, preprocessed_input)) {
+    return process(raw_input, output, block_events);
+}
+
+bool BeatNet::process(const std::vector<float>& raw_input, std::vector<float>& output, std::vector<BeatEvent>& events) {
+    return processInput({ raw_input.data(), nullptr, 1 }, static_cast<long>(raw_input.size()), output, events);
+}
+
+bool BeatNet::process(const float* interleaved, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events) {
+    if (!interleaved || numChannels <= 0 || numFrames < 0) {
+        events.clear();
+        return false;
+    }
+    return processInput({ interleaved, nullptr, numChannels }, numFrames, output, events);
+}
+
+bool BeatNet::process(const float* const* channels, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events) {
+    if (!channels || numChannels <= 0 || numFrames < 0) {
+        events.clear();
         return false;
     }
+    return processInput({ nullptr, channels, numChannels }, numFrames, output, events);
+}
+
+bool BeatNet::process(const std::vector<float>& raw_input, std::vector<float>& output, std::vector<BeatEvent>& events, std::vector<float>& activations) {
+    return processInput({ raw_input.data(), nullptr, 1 }, static_cast<long>(raw_input.size()), output, events, &activations);
+}
+
+bool BeatNet::process(const float* interleaved, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events,
+                      std::vector<float>& activations) {
+    if (!interleaved || numChannels <= 0 || numFrames < 0) {
+        events.clear();
+        return false;
+    }
+    return processInput({ interleaved, nullptr, numChannels }, numFrames, output, events, &activations);
+}
+
+bool BeatNet::process(const float* const* channels, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events,
+                      std::vector<float>& activations) {
+    if (!channels || numChannels <= 0 || numFrames < 0) {
+        events.clear();
+        return false;
+    }
+    return processInput({ nullptr, channels, numChannels }, numFrames, output, events, &activations);
+}
+
+void BeatNet::setFixedBatches(bool enabled) {
+    fixed_batches = enabled;
+}
+
+void BeatNet::finish(std::vector<BeatEvent>& events, std::vector<float>& activations) {
+    events.clear();
+    if (active_state) {
+        if (trace_recorder) {
+            trace_recorder->beginBlock(active_state->sample_rate, 0, 0);
+        }
+        flushHops(events, &activations);
+        double beat_time;
+        BeatEvent event;
+        while (lag_decoding && lag_decoder.flush(beat_time, event.activation, event.downbeat)) {
+            event.sample = toBlockSample(beat_time);
+            events.push_back(event);
+        }
+        if (trace_recorder) {
+            trace_recorder->endBlock(0.0);
+        }
+    }
+}
+
+void BeatNet::setTraceRecorder(TraceRecorder* recorder) {
+    trace_recorder = recorder;
+}
+
+BeatNet::StreamState* BeatNet::beginBlock(long num_frames) {
+    // switch to a new configuration at the block boundary, the old one is released off this thread
+    if (StreamState* next = pending_state.exchange(nullptr, std::memory_order_acquire)) {
+        if (active_state) {
+            next->start_time = active_state->start_time + active_state->samples_processed / active_state->sample_rate;
+            retireState(active_state);
+        }
+        active_state = next;
+    }
+    if (!active_state) {
+        return nullptr;
+    }
+
+    StreamState& state = *active_state;
+    block_start_time = state.start_time + state.samples_processed / state.sample_rate;
+    block_end_time = block_start_time + num_frames / state.sample_rate;
+    return active_state;
+}
+
+bool BeatNet::processInput(const HostInput& input, long num_frames, std::vector<float>& output, std::vector<BeatEvent>& events,
+                           std::vector<float>* activations) {
+    events.clear();
+    auto processing_start = std::chrono::steady_clock::now();
+    if (!beginBlock(num_frames)) {
+        return false;
+    }
+    StreamState& state = *active_state;
+    if (trace_recorder) {
+        trace_recorder->beginBlock(state.sample_rate, num_frames, input.num_channels);
+    }
+
+    // blocks larger than announced in setup() are split, so that no buffer needs to grow
+    bool has_output = false;
+    for (long chunk = 0; chunk < num_frames; chunk += state.block_size) {
+        long chunk_size = std::min<long>(state.block_size, num_frames - chunk);
+        const std::vector<float>& resampled = input.planar
+            ? state.resampler.resamplePlanar(input.planar, input.num_channels, chunk, chunk_size)
+            : state.resampler.resampleInterleaved(input.interleaved + chunk * input.num_channels, input.num_channels, chunk_size);
+        has_output = feedSamples(resampled.data(), static_cast<int>(resampled.size()), events, activations) || has_output;
+    }
+    if (!fixed_batches) {
+        flushHops(events, activations);
+    }
+    if (has_output) {
+        output.assign(buffers.last_output, buffers.last_output + 3);
+    }
+    state.samples_processed += num_frames;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - processing_start).count();
+    load_shedder.update(elapsed, num_frames / state.sample_rate);
+    if (trace_recorder) {
+        trace_recorder->endBlock(elapsed);
+    }
+    return has_output;
+}
+
+bool BeatNet::replaySamples(const float* samples, int numSamples, long numFrames, std::vector<float>& output,
+                            std::vector<BeatEvent>& events, std::vector<float>& activations) {
+    events.clear();
+    if (!beginBlock(numFrames)) {
+        return false;
+    }
+    bool has_output = feedSamples(samples, numSamples, events, &activations);
+    if (!fixed_batches) {
+        flushHops(events, &activations);
+    }
+    if (has_output) {
+        output.assign(buffers.last_output, buffers.last_output + 3);
+    }
+    active_state->samples_processed += numFrames;
+    return has_output;
+}
+
+bool BeatNet::replayHops(const TraceHop* hops, int numHops, bool recordedOutputs, long numFrames, std::vector<float>& output,
+                         std::vector<BeatEvent>& events, std::vector<float>& activations) {
+    events.clear();
+    if (!beginBlock(numFrames)) {
+        return false;
+    }
+    for (int i = 0; i < numHops; ++i) {
+        const TraceHop& hop = hops[i];
+        if (recordedOutputs) {
+            if (trace_recorder) {
+                trace_recorder->addHop(hop.centre, hop.source, hop.features);
+            }
+            std::copy(hop.output, hop.output + 3, buffers.last_output);
+            emitHop(hop.centre, events, &activations);
+        } else {
+            queueHop(hop.centre, hop.source, hop.features, events, &activations);
+        }
+    }
+    if (!fixed_batches) {
+        flushHops(events, &activations);
+    }
+    if (numHops > 0) {
+        output.assign(buffers.last_output, buffers.last_output + 3);
+    }
+    active_state->samples_processed += numFrames;
+    return numHops > 0;
+}
 
-    inference(output);
+bool BeatNet::feedSamples(const float* samples, int num_samples, std::vector<BeatEvent>& events, std::vector<float>* activations) {
+    if (trace_recorder) {
+        trace_recorder->addSamples(samples, num_samples);
+    }
+
+    // a block can complete any number of hops, each of them is a separate frame for the model
+    bool has_output = false;
+    int offset = 0;
+    while (offset < num_samples) {
+        bool frame_ready = false;
+        offset += feature_pipeline.process(samples + offset, num_samples - offset, frame_ready);
+        if (!frame_ready) {
+            continue;
+        }
+
+        if (energy_gate.process(feature_pipeline.frame().data(), FRAME_LENGTH)) {
+            feature_pipeline.skipFeatures();
+            queueHop(feature_pipeline.frameCentre(), HopSource::Silence, nullptr, events, activations);
+        } else {
+            feature_pipeline.computeFeatures(preprocessed_input);
+            HopSource source = load_shedder.shouldRun(feature_pipeline.frameIndex()) ? HopSource::Model : HopSource::Repeat;
+            queueHop(feature_pipeline.frameCentre(), source, preprocessed_input.data(), events, activations);
+        }
+        has_output = true;
+    }
+    return has_output;
+}
+
+void BeatNet::queueHop(long long centre, HopSource source, const float* features, std::vector<BeatEvent>& events,
+                       std::vector<float>* activations) {
+    if (trace_recorder) {
+        trace_recorder->addHop(centre, source, source == HopSource::Silence ? nullptr : features);
+    }
+
+    // hops are collected and sent through the model together at the end of the block
+    PendingHop hop { centre, source, batch_rows };
+    if (source == HopSource::Silence) {
+        // the hops gathered so far have to run before the LSTM state jumps to silence
+        flushHops(events, activations);
+        if (stateful_model) {
+            std::copy(std::begin(buffers.silence_state), std::end(buffers.silence_state), buffers.lstm_state[state_index]);
+        }
+    } else if (source == HopSource::Model) {
+        std::copy(features, features + FBANK_SIZE, buffers.batch_input + batch_rows * FBANK_SIZE);
+        batch_rows++;
+    }
+    pending_hops.push_back(hop);
+
+    if (static_cast<int>(pending_hops.size()) == MAX_BATCH_HOPS) {
+        flushHops(events, activations);
+    }
+}
+
+void BeatNet::flushHops(std::vector<BeatEvent>& events, std::vector<float>* activations) {
+    if (batch_rows > 0) {
+        runModel(batch_rows);
+    }
+
+    for (const PendingHop& hop : pending_hops) {
+        if (hop.source == HopSource::Model) {
+            // output is [1, 3, T]
+            for (int i = 0; i < 3; ++i) {
+                buffers.last_output[i] = buffers.batch_output[i * batch_rows + hop.row];
+            }
+        } else if (hop.source == HopSource::Silence) {
+            std::copy(buffers.silence_output, buffers.silence_output + 3, buffers.last_output);
+        }
+        // HopSource::Repeat keeps the previous output
+        emitHop(hop.centre, events, activations);
+    }
+    pending_hops.clear();
+    batch_rows = 0;
+}
+
+void BeatNet::emitHop(long long centre, std::vector<BeatEvent>& events, std::vector<float>* activations) {
+    if (trace_recorder) {
+        trace_recorder->addOutput(buffers.last_output);
+    }
+    if (activations) {
+        activations->insert(activations->end(), buffers.last_output, buffers.last_output + 3);
+    }
+
+    tempo_estimator.process(buffers.last_output[0] + buffers.last_output[1]);
+
+    double beat_time;
+    BeatEvent event;
+    // the peak picker keeps running for getTempo() and predictNextBeat()
+    bool detected = beat_detector.process(buffers.last_output[0], buffers.last_output[1], frameTime(centre), beat_time, event.activation, event.downbeat);
+    if (lag_decoding) {
+        lag_decoder.setBeamWidth(lag_beam / (1 + load_shedder.level()));
+        detected = lag_decoder.process(buffers.last_output, frameTime(centre), beat_time, event.activation, event.downbeat);
+    }
+    if (detected) {
+        event.sample = toBlockSample(beat_time);
+        events.push_back(event);
+    }
+}
+
+double BeatNet::frameTime(long long frame_centre) const {
+    // the model reports the beat at the centre of the frame, corrected for the delays in front of it
+    double centre = static_cast<double>(frame_centre) - active_state->resampler.getLatency();
+    return centre / SR_BEATNET - model_latency;
+}
+
+long long BeatNet::toBlockSample(double time) const {
+    return static_cast<long long>(std::llround((time - block_start_time) * active_state->sample_rate));
+}
+
+bool BeatNet::predictNextBeat(long long& sample) const {
+    double beat_time;
+    if (!active_state || !beat_detector.predictNextBeat(block_end_time, beat_time)) {
+        return false;
+    }
+    sample = toBlockSample(beat_time);
     return true;
 }
 
-void BeatNet::inference(std::vector<float>& output) {
-    OrtValue* input_tensor = nullptr;
+double BeatNet::getTempo() const {
+    return beat_detector.tempo();
+}
 
-    CreateTensorWithDataAsOrtValue(
-        memory_info,
-        preprocessed_input.data(),
-        preprocessed_input.size() * sizeof(float),
-        input_shape.data(),
-        input_shape.size(),
-        ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,
-        &input_tensor
-    );
+double BeatNet::getStableTempo() const {
+    return tempo_estimator.tempo();
+}
+
+float BeatNet::getTempoConfidence() const {
+    return tempo_estimator.confidence();
+}
+
+void BeatNet::setFixedLagDecoding(bool enabled, double lagSeconds, int beamWidth) {
+    lag_decoding = enabled;
+    lag_beam = beamWidth;
+    if (enabled) {
+        lag_decoder.configure(static_cast<int>(std::lround(lagSeconds * SR_BEATNET / HOP_SIZE)), beamWidth,
+                              static_cast<double>(SR_BEATNET) / HOP_SIZE);
+    }
+}
+
+bool BeatNet::isFixedLagDecoding() const {
+    return lag_decoding;
+}
+
+bool BeatNet::isStatefulModel() const {
+    return stateful_model;
+}
+
+void BeatNet::setModelLatency(double seconds) {
+    model_latency = seconds;
+}
+
+double BeatNet::getLatency() const {
+    std::lock_guard<std::mutex> lock(setup_mutex);
+    if (!configured_state) {
+        return 0.0;
+    }
+    double frame_delay = static_cast<double>(FRAME_LENGTH - FRAME_LENGTH / 2) / SR_BEATNET;
+    return (configured_state->resampler.getLatency() / SR_BEATNET + frame_delay + model_latency) * configured_state->sample_rate;
+}
+
+void BeatNet::setEnergyGate(bool enabled, float thresholdDb, float fluxDb) {
+    energy_gate.configure(enabled, thresholdDb, fluxDb);
+}
+
+long long BeatNet::getGatedFrames() const {
+    return energy_gate.gatedFrames();
+}
+
+long long BeatNet::getTotalFrames() const {
+    return energy_gate.totalFrames();
+}
+
+void BeatNet::setLoadShedding(bool enabled, double budget) {
+    load_shedder.configure(enabled, budget);
+}
+
+int BeatNet::getLoadLevel() const {
+    return load_shedder.level();
+}
+
+double BeatNet::getLoad() const {
+    return load_shedder.load();
+}
+
+long long BeatNet::getDeadlineMisses() const {
+    return load_shedder.deadlineMisses();
+}
+
+long long BeatNet::getSaturatedDeadlineMisses() const {
+    return load_shedder.saturatedMisses();
+}
 
-    OrtValue* output_tensor = nullptr;
-    const char* input_names[] = { input_name };
-    const char* output_names[] = { output_name };
+bool BeatNet::configureFFT(FFTBackendType backend, bool exactLength) {
+    int size = exactLength ? FRAME_LENGTH : FRAME_SIZE_POW2;
+    // keep the current transform if the requested one cannot be created
+    std::vector<FFTBackendType> candidates = FFTBackend::available(size);
+    bool usable = backend == FFTBackendType::Auto ? !candidates.empty()
+                                                  : std::find(candidates.begin(), candidates.end(), backend) != candidates.end();
+    if (!usable) {
+        std::cerr << "FFT backend " << FFTBackend::name(backend) << " cannot run transforms of " << size << " samples" << std::endl;
+        return false;
+    }
+    feature_pipeline.configureFFT(backend, exactLength);
+    return feature_pipeline.transform().size() == size;
+}
 
-    Run(session, run_options,
-             input_names, &input_tensor, 1,
-             output_names, 1,
-             &output_tensor);
+const char* BeatNet::getFFTBackendName() const {
+    return feature_pipeline.transform().backendName();
+}
 
-    float* output_data = nullptr;
-    GetTensorMutableData(output_tensor, (void**)&output_data);
+double BeatNet::getFFTNsPerFrame() const {
+    return feature_pipeline.transform().nsPerFrame();
+}
 
-    output.resize(3);  // Assuming [1, 3, 1] shape
-    for (int i = 0; i < 3; ++i) {
-        output[i] = output_data[i];
+void BeatNet::createTensors() {
+    // one input/output tensor per batch length, wrapping the preallocated buffers, so that Run needs no new tensors
+    for (int hops = 1; hops <= MAX_BATCH_HOPS; ++hops) {
+        const int64_t input_dims[] = { 1, hops, FBANK_SIZE };
+        const int64_t output_dims[] = { 1, 3, hops };
+        CreateTensorWithDataAsOrtValue(memory_info, buffers.batch_input, hops * FBANK_SIZE * sizeof(float),
+                                       input_dims, 3, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &input_tensors[hops - 1]);
+        CreateTensorWithDataAsOrtValue(memory_info, buffers.batch_output, 3 * hops * sizeof(float),
+                                       output_dims, 3, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &output_tensors[hops - 1]);
+
+        // a model without state inputs is run hop by hop (see runModel)
+        const int64_t hop_input_dims[] = { 1, 1, FBANK_SIZE };
+        CreateTensorWithDataAsOrtValue(memory_info, buffers.batch_input + (hops - 1) * FBANK_SIZE, FBANK_SIZE * sizeof(float),
+                                       hop_input_dims, 3, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &hop_input_tensors[hops - 1]);
     }
+    const int64_t hop_output_dims[] = { 1, 3, 1 };
+    CreateTensorWithDataAsOrtValue(memory_info, buffers.hop_output, 3 * sizeof(float),
+                                   hop_output_dims, 3, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &hop_output_tensor);
 
-    printOutputShape(output_tensor);
+    if (!stateful_model) {
+        return;
+    }
+    // [hidden, cell] of every layer, double buffered: Run reads one buffer and writes the other
+    const int64_t state_dims[] = { LSTM_NUM_LAYERS, 1, LSTM_HIDDEN_SIZE };
+    const size_t state_size = LSTM_NUM_LAYERS * LSTM_HIDDEN_SIZE;
+    for (int buffer = 0; buffer < 2; ++buffer) {
+        for (int part = 0; part < 2; ++part) {
+            CreateTensorWithDataAsOrtValue(memory_info, buffers.lstm_state[buffer] + part * state_size, state_size * sizeof(float),
+                                           state_dims, 3, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &state_tensors[buffer][part]);
+        }
+    }
+}
 
-    ReleaseValue(input_tensor);
-    ReleaseValue(output_tensor);
+void BeatNet::releaseTensors() {
+    for (OrtValue*& tensor : input_tensors) { if (tensor) ReleaseValue(tensor); tensor = nullptr; }
+    for (OrtValue*& tensor : output_tensors) { if (tensor) ReleaseValue(tensor); tensor = nullptr; }
+    for (OrtValue*& tensor : hop_input_tensors) { if (tensor) ReleaseValue(tensor); tensor = nullptr; }
+    if (hop_output_tensor) ReleaseValue(hop_output_tensor);
+    hop_output_tensor = nullptr;
+    for (auto& buffer : state_tensors) {
+        for (OrtValue*& tensor : buffer) { if (tensor) ReleaseValue(tensor); tensor = nullptr; }
+    }
+}
+
+void BeatNet::initSilence() {
+    // features of digital silence are all zero (log10(0 + 1) and no difference)
+    std::fill(std::begin(buffers.batch_input), std::end(buffers.batch_input), 0.0f);
+    if (!stateful_model) {
+        runModel(1);
+        std::copy(buffers.batch_output, buffers.batch_output + 3, buffers.silence_output);
+    } else {
+        // let the LSTM settle on silence, then start the stream from the zero state again
+        runModel(MAX_BATCH_HOPS);
+        runModel(MAX_BATCH_HOPS);
+        for (int i = 0; i < 3; ++i) {
+            buffers.silence_output[i] = buffers.batch_output[i * MAX_BATCH_HOPS + MAX_BATCH_HOPS - 1];
+        }
+        std::copy(std::begin(buffers.lstm_state[state_index]), std::end(buffers.lstm_state[state_index]), buffers.silence_state);
+        std::fill(std::begin(buffers.lstm_state[state_index]), std::end(buffers.lstm_state[state_index]), 0.0f);
+    }
+    std::copy(buffers.silence_output, buffers.silence_output + 3, buffers.last_output);
+}
+
+void BeatNet::runModel(int hops) {
+    OrtStatus* status = nullptr;
+
+    if (stateful_model) {
+        // all hops in one Run, the LSTM state goes from one buffer to the other
+        const char* input_names[] = { input_name, state_input_names[0], state_input_names[1] };
+        const char* output_names[] = { output_name, state_output_names[0], state_output_names[1] };
+        const OrtValue* inputs[] = { input_tensors[hops - 1], state_tensors[state_index][0], state_tensors[state_index][1] };
+        OrtValue* outputs[] = { output_tensors[hops - 1], state_tensors[1 - state_index][0], state_tensors[1 - state_index][1] };
+        status = Run(session, run_options, input_names, inputs, 3, output_names, 3, outputs);
+        state_index = 1 - state_index;
+        if (RTLog::enabled(LogLevel::Debug))
+            printOutputShape(output_tensors[hops - 1]);
+    } else {
+        // the model starts from a zero state on every Run, so batching hops would change the results
+        const char* input_names[] = { input_name };
+        const char* output_names[] = { output_name };
+        for (int hop = 0; hop < hops && !status; ++hop) {
+            status = Run(session, run_options, input_names, &hop_input_tensors[hop], 1, output_names, 1, &hop_output_tensor);
+            for (int i = 0; i < 3; ++i) {
+                buffers.batch_output[i * hops + hop] = buffers.hop_output[i];
+            }
+        }
+        if (RTLog::enabled(LogLevel::Debug))
+            printOutputShape(hop_output_tensor);
+    }
+
+    if (status) {
+        RTLOG_ERROR("Inference failed: %s", ort->GetErrorMessage(status));
+        ort->ReleaseStatus(status);
+    }
 }
 
 void BeatNet::printOutputShape(OrtValue* output_tensor) {
@@ -203,15 +749,17 @@ void BeatNet::printOutputShape(OrtValue* output_tensor) {
 
     size_t dim_count;
     GetDimensionsCount(shape_info, &dim_count);
-    std::vector<int64_t> shape(dim_count);
-    GetDimensions(shape_info, shape.data(), dim_count);
-
-    std::cout << "Output shape: [";
-    for (size_t i = 0; i < shape.size(); ++i) {
-        std::cout << shape[i];
-        if (i < shape.size() - 1) std::cout << ", ";
-    }
-    std::cout << "]" << std::endl;
+    int64_t shape[8];
+    dim_count = std::min(dim_count, sizeof(shape) / sizeof(shape[0]));
+    GetDimensions(shape_info, shape, dim_count);
+
+    char text[128];
+    int length = 0;
+    for (size_t i = 0; i < dim_count && length < static_cast<int>(sizeof(text)); ++i)
+        length += std::snprintf(text + length, sizeof(text) - length, i + 1 < dim_count ? "%lld, " : "%lld", static_cast<long long>(shape[i]));
+    if (dim_count == 0)
+        text[0] = '\0';
+    RTLOG_DEBUG("Output shape: [%s]", text);
 
     ReleaseTensorTypeAndShapeInfo(shape_info);
-}
\ No newline at end of file
+}
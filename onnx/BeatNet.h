@@ -3,24 +3,25 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
 #include "onnxruntime_c_api.h"
+#include "arena.h"
 #include "resampler.h"
-#include "frameprocessor.h"
-#include "fftprocessor.h"
-#include "filterbankprocessor.h"
-#include "logspecutils.h"
-
-constexpr int SR_BEATNET {22050}; 
-constexpr double MS_FR_PAPER {0.093};
-constexpr double MS_HOP_PAPER {0.046}; 
-constexpr double MS_FR_GITHUB {0.064};
-constexpr double MS_HOP_GITHUB {0.020};
-constexpr int FRAME_LENGTH {static_cast<int>(SR_BEATNET*MS_FR_GITHUB)}; // 1411
-constexpr int HOP_SIZE {static_cast<int>(SR_BEATNET*MS_HOP_GITHUB)}; // 441
-constexpr int FFT_SIZE { FRAME_LENGTH / 2 + 1}; // 706
-constexpr int FRAME_SIZE_POW2 {2048}; // this is the minumum higher than FRAME_LENGTH (1411) that is a power-of-two value.
-constexpr int FBANK_SIZE {272};
-constexpr int BANKS_PER_OCTAVE {16}; // {24};;
+#include "featuregeometry.h"
+#include "staticfeaturepipeline.h"
+#include "beateventdetector.h"
+#include "fixedlagdecoder.h"
+#include "energygate.h"
+#include "loadshedder.h"
+#include "tempoestimator.h"
+#include "threadconfig.h"
+#include "tracefile.h"
+
+constexpr int LSTM_NUM_LAYERS {2};     // BDA(272, 150, 2) in BeatNet.py
+constexpr int LSTM_HIDDEN_SIZE {150};
+constexpr int MAX_BATCH_HOPS {32};     // hops sent to the model in one Run
+constexpr double MS_MODEL_LATENCY {0.084 - MS_FR_GITHUB / 2}; // streaming delay noted in BeatNet.py minus the frame centre, which is compensated separately
 
 using OrtGetApiBaseFn = const OrtApiBase* (*)();
 using OrtCreateTensorWithDataAsOrtValueFn = OrtStatus* (*)
@@ -53,12 +54,18 @@ using OrtReleaseTensorTypeAndShapeInfoFn = void (*)(OrtTensorTypeAndShapeInfo*);
 using OrtCreateEnvFn = OrtStatus* (ORT_API_CALL *)(OrtLoggingLevel, const char*, OrtEnv**) noexcept;
 using OrtCreateSessionOptionsFn = OrtStatus* (ORT_API_CALL *)(OrtSessionOptions**);
 using OrtSetIntraOpNumThreadsFn = OrtStatus* (ORT_API_CALL *)(OrtSessionOptions*, int);
+using OrtSetSessionExecutionModeFn = OrtStatus* (ORT_API_CALL *)(OrtSessionOptions*, ExecutionMode);
+using OrtAddSessionConfigEntryFn = OrtStatus* (ORT_API_CALL *)(OrtSessionOptions*, const char*, const char*);
+using OrtSetCustomCreateThreadFn = OrtStatus* (ORT_API_CALL *)(OrtSessionOptions*, OrtCustomCreateThreadFn);
+using OrtSetCustomThreadCreationOptionsFn = OrtStatus* (ORT_API_CALL *)(OrtSessionOptions*, void*);
+using OrtSetCustomJoinThreadFn = OrtStatus* (ORT_API_CALL *)(OrtSessionOptions*, OrtCustomJoinThreadFn);
 using OrtCreateRunOptionsFn = OrtStatus* (ORT_API_CALL *)(OrtRunOptions**);
 using OrtCreateCpuMemoryInfoFn = OrtStatus* (ORT_API_CALL *)(OrtAllocatorType, OrtMemType, OrtMemoryInfo**);
 using OrtGetAllocatorWithDefaultOptionsFn = OrtStatus* (ORT_API_CALL *)(OrtAllocator**);
 using OrtCreateSessionFn = OrtStatus* (ORT_API_CALL *)(const OrtEnv*, const ORTCHAR_T*, const OrtSessionOptions*, OrtSession**) noexcept;
 using OrtSessionGetInputNameFn = OrtStatus* (ORT_API_CALL *)(const OrtSession*, size_t, OrtAllocator*, char**) noexcept;
 using OrtSessionGetOutputNameFn = OrtStatus* (ORT_API_CALL *)(const OrtSession*, size_t, OrtAllocator*, char**) noexcept;
+using OrtSessionGetCountFn = OrtStatus* (ORT_API_CALL *)(const OrtSession*, size_t*) noexcept;
 using OrtAllocatorFreeFn = OrtStatus* (ORT_API_CALL *)(OrtAllocator*, void*) noexcept;
 using OrtReleaseSessionFn = void (ORT_API_CALL *)(OrtSession*);
 using OrtReleaseSessionOptionsFn = void (ORT_API_CALL *)(OrtSessionOptions*);
@@ -74,15 +81,136 @@ public:
         OrtLoggingLevel ortlogginglevel=ORT_LOGGING_LEVEL_WARNING,
         int intraopnumthreads =1
     );
+    // Full control over the threads of the ONNX Runtime session, see ThreadConfig.
+    BeatNet(
+        std::string modelPath,
+        const ThreadConfig& threadConfig,
+        const char* ortenvname = "BeatNet",
+        OrtLoggingLevel ortlogginglevel = ORT_LOGGING_LEVEL_WARNING
+    );
     ~BeatNet();
 
-    void setup(double sampleRate, int samplesPerBlock);
+    // Prepares the host dependent state and hands it over to the audio thread, which picks it up at the
+    // start of its next process() call. It does not block process(), so it may be called from a
+    // non real-time thread while audio is running. The model and feature history are left untouched.
+    bool setup(double sampleRate, int samplesPerBlock);
 
     bool process(const std::vector<float>& raw_input, std::vector<float>& output);
-    
+    // Also reports the beats/downbeats detected while processing this block, positioned relative to its first sample.
+    // Reserve some capacity in events to keep the call allocation-free.
+    bool process(const std::vector<float>& raw_input, std::vector<float>& output, std::vector<BeatEvent>& events);
+    // Host buffers with any number of channels, read in place: the channels are averaged into the
+    // resampler's preallocated downmix buffer, so the host does not have to make a mono copy first.
+    // Interleaved (numFrames * numChannels samples) or planar (numChannels pointers to numFrames samples).
+    bool process(const float* interleaved, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events);
+    bool process(const float* const* channels, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events);
+    // Also appends the activations (beat, downbeat, non-beat) of every hop that left the model during this call.
+    bool process(const std::vector<float>& raw_input, std::vector<float>& output, std::vector<BeatEvent>& events, std::vector<float>& activations);
+    bool process(const float* interleaved, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events,
+                 std::vector<float>& activations);
+    bool process(const float* const* channels, int numChannels, int numFrames, std::vector<float>& output, std::vector<BeatEvent>& events,
+                 std::vector<float>& activations);
+
+    // Offline use: hops are only sent to the model in full batches of MAX_BATCH_HOPS, whatever the block size,
+    // so that the results do not depend on how the input is split. finish() runs the hops still waiting.
+    // Load shedding depends on timing and should be off as well for reproducible results.
+    void setFixedBatches(bool enabled);
+    void finish(std::vector<BeatEvent>& events, std::vector<float>& activations);
+
+    // Records every following block into the trace (not owned, nullptr stops recording), see TraceRecorder.
+    void setTraceRecorder(TraceRecorder* recorder);
+    // Replay entry points used by TraceReplayer, in place of process(): numFrames host frames worth of resampled
+    // mono samples go straight into the framer, or recorded hops go to the model (or, with recordedOutputs, straight
+    // to the beat detector with their recorded output).
+    bool replaySamples(const float* samples, int numSamples, long numFrames, std::vector<float>& output,
+                       std::vector<BeatEvent>& events, std::vector<float>& activations);
+    bool replayHops(const TraceHop* hops, int numHops, bool recordedOutputs, long numFrames, std::vector<float>& output,
+                    std::vector<BeatEvent>& events, std::vector<float>& activations);
+
+    // Position of the next expected beat relative to the first sample of the last processed block.
+    bool predictNextBeat(long long& sample) const;
+    double getTempo() const;
+    // Tempo from the periodicity of the beat activation (TempoEstimator), steadier than getTempo() which
+    // follows the detected beat intervals. 0 until about 4 s of audio have been analysed.
+    double getStableTempo() const;
+    float getTempoConfidence() const;
+
+    // Decides beats with FixedLagDecoder instead of the peak picker: a bar pointer model (as the offline DBN of
+    // the Python BeatNet) smoothed over lagSeconds of activations, so the events are reported that much later
+    // and come closer to the offline result the longer the lag. beamWidth is the number of hypotheses kept per
+    // frame; with load shedding it is divided by (load level + 1). finish() reports the beats still undecided.
+    // Allocates, so call it before audio is running. Off by default.
+    void setFixedLagDecoding(bool enabled, double lagSeconds = 1.0, int beamWidth = 1024);
+    bool isFixedLagDecoding() const;
+
+    // Whether the model passes the LSTM state in and out (h0/c0, hn/cn, see exportModel.py). Only then the
+    // hops of one process call go through a single Run and the state carries over from hop to hop.
+    bool isStatefulModel() const;
+
+    // Delay between a beat in the audio and the activation peak of the model, in seconds.
+    void setModelLatency(double seconds);
+    // Fixed delay of the whole chain (resampler, frame centre, model) in host samples.
+    double getLatency() const;
+
+    // Quiet hops (energy below thresholdDb and rising less than fluxDb over the previous hop) skip the FFT,
+    // filterbank and inference; they report the model's response to silence instead. Off by default.
+    void setEnergyGate(bool enabled, float thresholdDb = -60.0f, float fluxDb = 6.0f);
+    // hops skipped by the gate and hops seen overall, safe to read from any thread
+    long long getGatedFrames() const;
+    long long getTotalFrames() const;
+
+    // Degrades gracefully when process() takes more than `budget` of the block duration, see LoadShedder.
+    // Off by default.
+    void setLoadShedding(bool enabled, double budget = 0.5);
+    // current quality level, 0 is full quality; at level n the model runs on every (n + 1)th hop and the
+    // hops in between repeat the last model output, they are not interpolated
+    int getLoadLevel() const;
+    // processing time / duration of the last block
+    double getLoad() const;
+    long long getDeadlineMisses() const;
+    // deadline misses at the highest level, where load shedding had nothing left to drop
+    long long getSaturatedDeadlineMisses() const;
+
+    // Selects the FFT backend of the feature extraction, Auto uses FFTAutoTuner (see FFTAutoTuner::setEnabled).
+    // exactLength skips the zero padding to FRAME_SIZE_POW2, the backend has to support FRAME_LENGTH sized
+    // transforms then. That is a 1411 instead of a 2048 point FFT: bin k lies at k * 22050 / 1411 Hz instead of
+    // k * 22050 / 2048 Hz while the filterbank stays laid out for 2048 points, so the features the model sees
+    // change and the activations differ from the trained setup. Reallocates the transform, so call it before
+    // audio is running.
+    bool configureFFT(FFTBackendType backend, bool exactLength = false);
+    const char* getFFTBackendName() const;
+    // measured cost of one transform of the active backend, in nanoseconds
+    double getFFTNsPerFrame() const;
+
 private:    
-    float SR;
-    int bufferSize;
+    // Everything that depends on the host sample rate and block size.
+    struct StreamState {
+        StreamState(double sampleRate, int samplesPerBlock);
+
+        double sample_rate;
+        int block_size;
+        Resampler resampler;
+        double start_time;            // stream time at which the state became active
+        long long samples_processed;  // host samples processed since then
+        StreamState* next_retired;
+    };
+
+    StreamState* active_state;                  // only touched by the audio thread
+    std::atomic<StreamState*> pending_state;    // published by setup(), taken by process()
+    std::atomic<StreamState*> retired_states;   // lock-free stack of states released by process()
+    StreamState* configured_state;              // most recent state created by setup()
+    mutable std::mutex setup_mutex;
+    // Layout of the block handed to process()
+    struct HostInput {
+        const float* interleaved;
+        const float* const* planar;
+        int num_channels;
+    };
+    bool processInput(const HostInput& input, long num_frames, std::vector<float>& output, std::vector<BeatEvent>& events,
+                      std::vector<float>* activations = nullptr);
+
+    void retireState(StreamState* state);
+    void reclaimStates();
 	const std::string defaultModelPath{ "beatnet_bda.onnx" };
 
     // ONNX Runtime
@@ -95,6 +223,7 @@ private:
     OrtRunOptions* run_options;
     const char* input_name;
     const char* output_name;
+    ThreadConfig thread_config;     // the session's threads keep a pointer to the inference placement
 
     // run-time linking
     void* onnxruntime_handle = nullptr;
@@ -110,12 +239,20 @@ private:
     OrtCreateEnvFn CreateEnv;
     OrtCreateSessionOptionsFn CreateSessionOptions;
     OrtSetIntraOpNumThreadsFn SetIntraOpNumThreads;
+    OrtSetIntraOpNumThreadsFn SetInterOpNumThreads;
+    OrtSetSessionExecutionModeFn SetSessionExecutionMode;
+    OrtAddSessionConfigEntryFn AddSessionConfigEntry;
+    OrtSetCustomCreateThreadFn SessionOptionsSetCustomCreateThreadFn;
+    OrtSetCustomThreadCreationOptionsFn SessionOptionsSetCustomThreadCreationOptions;
+    OrtSetCustomJoinThreadFn SessionOptionsSetCustomJoinThreadFn;
     OrtCreateRunOptionsFn CreateRunOptions;
     OrtCreateCpuMemoryInfoFn CreateCpuMemoryInfo;
     OrtGetAllocatorWithDefaultOptionsFn GetAllocatorWithDefaultOptions;
     OrtCreateSessionFn CreateSession;
     OrtSessionGetInputNameFn SessionGetInputName;
     OrtSessionGetOutputNameFn SessionGetOutputName;
+    OrtSessionGetCountFn SessionGetInputCount;
+    OrtSessionGetCountFn SessionGetOutputCount;
     OrtAllocatorFreeFn AllocatorFree;
     OrtReleaseSessionFn ReleaseSession;
     OrtReleaseSessionOptionsFn ReleaseSessionOptions;
@@ -123,22 +260,82 @@ private:
     OrtReleaseRunOptionsFn ReleaseRunOptions;
     OrtReleaseEnvFn ReleaseEnv;
 
-    // Preprocessing
-    Resampler resampler;
-    FramedSignalProcessor signal_processor;
-    FFTProcessor fft_processor;
-    FilterBankProcessor filterbank_processor;
-    std::vector<float> preprocessed_input;
-    std::vector<int64_t> input_shape;
-    std::vector<float> spectrum;
-    std::vector<float> filters;
-    std::vector<float> log_fb;
-    std::vector<float> diff;
-    std::vector<float> prev_log_fb;
-
-    // helper functions - preprocess for feature extraction and inference for model utilization
-    bool preprocess(const std::vector<float>& raw_input, std::vector<float>& preprocessed_input);
-    void inference(std::vector<float>& output);
+    // The state read and written on every hop, in one arena and in the order a hop touches it. Every group
+    // starts on its own cache line; the ORT tensors wrap the arrays directly.
+    struct StreamBuffers {
+        alignas(Arena::ALIGNMENT) float last_output[3];     // repeated on hops that skip inference
+        float silence_output[3];                            // model output for silent features, reported for gated hops
+        float hop_output[3];
+        alignas(Arena::ALIGNMENT) StaticFeaturePipeline<GithubGeometry> feature_pipeline;
+        alignas(Arena::ALIGNMENT) StaticFeaturePipeline<GithubGeometry>::Features preprocessed_input;
+        alignas(Arena::ALIGNMENT) float batch_input[MAX_BATCH_HOPS * FBANK_SIZE];
+        alignas(Arena::ALIGNMENT) float batch_output[3 * MAX_BATCH_HOPS];   // [3, hops] of the last run
+        alignas(Arena::ALIGNMENT) float lstm_state[2][2 * LSTM_NUM_LAYERS * LSTM_HIDDEN_SIZE];  // hidden and cell state, double buffered
+        alignas(Arena::ALIGNMENT) float silence_state[2 * LSTM_NUM_LAYERS * LSTM_HIDDEN_SIZE];  // state the LSTM settles on during silence
+    };
+    Arena arena;
+    StreamBuffers& buffers;
+
+    // Preprocessing, specialised at compile time for the geometry the model was trained with
+    StaticFeaturePipeline<GithubGeometry>& feature_pipeline;
+    StaticFeaturePipeline<GithubGeometry>::Features& preprocessed_input;
+
+    // Inference. The hops completed during a process() call are gathered and run through the model together.
+    using HopSource = TraceHopSource;
+    struct PendingHop {
+        long long centre;   // frame centre in resampled samples
+        HopSource source;   // model output, silence (energy gate) or repeat of the previous hop (load shedding)
+        int row;            // row in buffers.batch_input for HopSource::Model
+    };
+    std::vector<PendingHop> pending_hops;
+    int batch_rows = 0;
+    bool fixed_batches = false;
+    OrtValue* input_tensors[MAX_BATCH_HOPS] = {};     // [1, T, FBANK_SIZE] for T = index + 1
+    OrtValue* output_tensors[MAX_BATCH_HOPS] = {};    // [1, 3, T]
+    OrtValue* hop_input_tensors[MAX_BATCH_HOPS] = {}; // [1, 1, FBANK_SIZE] per row, for models without state
+    OrtValue* hop_output_tensor = nullptr;
+
+    // LSTM state, when the model exposes it
+    bool stateful_model = false;
+    const char* state_input_names[2] = {};
+    const char* state_output_names[2] = {};
+    OrtValue* state_tensors[2][2] = {}; // [buffer][hidden, cell]
+    int state_index = 0;                // buffer of buffers.lstm_state holding the current state
+
+    // Energy gate
+    EnergyGate energy_gate;
+
+    // Load shedding
+    LoadShedder load_shedder;
+
+    // Beat events
+    BeatEventDetector beat_detector;
+    FixedLagDecoder lag_decoder;
+    bool lag_decoding = false;
+    int lag_beam = 0;
+    TempoEstimator tempo_estimator;
+    std::vector<BeatEvent> block_events;
+    double model_latency;
+    double block_start_time; // stream time of the first sample of the last block, in seconds
+    double block_end_time;
+
+    // Tracing
+    TraceRecorder* trace_recorder = nullptr;
+
+    // helper functions - inference for model utilization
+    void createTensors();
+    void releaseTensors();
+    void initSilence();
+    void runModel(int hops);
+    StreamState* beginBlock(long num_frames);
+    bool feedSamples(const float* samples, int num_samples, std::vector<BeatEvent>& events, std::vector<float>* activations);
+    void queueHop(long long centre, HopSource source, const float* features, std::vector<BeatEvent>& events,
+                  std::vector<float>* activations);
+    void flushHops(std::vector<BeatEvent>& events, std::vector<float>* activations);
+    void emitHop(long long centre, std::vector<BeatEvent>& events, std::vector<float>* activations);
+    double frameTime(long long frame_centre) const;
+    long long toBlockSample(double time) const;
+    // only called with the log at debug level, querying the shape allocates inside ONNX Runtime
     void printOutputShape(OrtValue* output_tensors);
 
 };
@@ -0,0 +1,92 @@
+#include "arena.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace {
+    constexpr size_t HUGE_PAGE_SIZE = 2u << 20;
+
+    std::atomic<bool> huge_pages_enabled { false };
+}
+
+Arena::Arena(size_t bytes):
+    size(align(bytes > 0 ? bytes : 1))
+{
+#if defined(__linux__)
+    if (huge_pages_enabled) {
+        size_t mapped_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void* block = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED) {
+            huge_pages = true;
+        } else {
+            // no reserved huge pages: ask for a transparent one, the mapping is 2 MiB long so it can be backed by one
+            block = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (block != MAP_FAILED)
+                huge_pages = madvise(block, mapped_size, MADV_HUGEPAGE) == 0;
+#endif
+        }
+        if (block != MAP_FAILED) {
+            memory = static_cast<char*>(block);
+            size = mapped_size;
+            mapped = true;
+        }
+    }
+#endif
+    if (!memory)
+        memory = static_cast<char*>(::operator new(size, std::align_val_t(ALIGNMENT)));
+    // touch every page now rather than on the audio thread
+    std::memset(memory, 0, size);
+}
+
+Arena::~Arena()
+{
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+        it->destroy(it->object);
+#if defined(__linux__)
+    if (mapped) {
+        munmap(memory, size);
+        return;
+    }
+#endif
+    ::operator delete(memory, std::align_val_t(ALIGNMENT));
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment)
+{
+    alignment = alignment > ALIGNMENT ? alignment : ALIGNMENT;
+    size_t start = (offset + alignment - 1) / alignment * alignment;
+    if (start > size || size - start < bytes)
+        return nullptr;
+    // the next allocation starts on a new cache line, so neighbours never share one
+    offset = start + align(bytes);
+    return memory + start;
+}
+
+size_t Arena::capacity() const
+{
+    return size;
+}
+
+size_t Arena::used() const
+{
+    return offset;
+}
+
+bool Arena::usesHugePages() const
+{
+    return huge_pages;
+}
+
+void Arena::setHugePages(bool enabled)
+{
+    huge_pages_enabled = enabled;
+}
+
+bool Arena::hugePagesEnabled()
+{
+    return huge_pages_enabled;
+}
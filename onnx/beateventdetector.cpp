@@ -0,0 +1,87 @@
+#include "beateventdetector.h"
+#include <algorithm>
+#include <cmath>
+
+BeatEventDetector::BeatEventDetector(float threshold, double min_bpm, double max_bpm):
+    threshold(threshold),
+    min_interval(60.0 / max_bpm),
+    max_interval(60.0 / min_bpm)
+{
+    reset();
+}
+
+void BeatEventDetector::reset()
+{
+    prev_activation = 0.0f;
+    prev_beat = 0.0f;
+    prev_downbeat = 0.0f;
+    prev_time = 0.0;
+    rising = false;
+    has_last_beat = false;
+    last_beat_time = 0.0;
+    beat_interval = 0.0;
+}
+
+bool BeatEventDetector::process(float beat, float downbeat, double time, double& beat_time, float& activation, bool& is_downbeat)
+{
+    // same as the particle filter, a frame is a beat candidate if either of the two activations is high
+    float current = std::max(beat, downbeat);
+    bool detected = false;
+
+    if (rising && current < prev_activation && prev_activation >= threshold)
+    {
+        if (!has_last_beat || prev_time - last_beat_time >= min_interval)
+        {
+            if (has_last_beat)
+                updateTempo(prev_time - last_beat_time);
+
+            beat_time = prev_time;
+            activation = prev_activation;
+            is_downbeat = prev_downbeat > prev_beat;
+            has_last_beat = true;
+            last_beat_time = prev_time;
+            detected = true;
+        }
+    }
+
+    if (current > prev_activation)
+        rising = true;
+    else if (current < prev_activation)
+        rising = false;
+
+    prev_activation = current;
+    prev_beat = beat;
+    prev_downbeat = downbeat;
+    prev_time = time;
+    return detected;
+}
+
+void BeatEventDetector::updateTempo(double interval)
+{
+    // a skipped beat shows up as a doubled interval, fold it back before averaging
+    if (beat_interval > 0.0 && std::abs(interval - 2.0 * beat_interval) < 0.1 * beat_interval)
+        interval *= 0.5;
+
+    if (interval < min_interval || interval > max_interval)
+        return;
+
+    if (beat_interval == 0.0)
+        beat_interval = interval;
+    else
+        beat_interval = 0.75 * beat_interval + 0.25 * interval;
+}
+
+bool BeatEventDetector::predictNextBeat(double time, double& beat_time) const
+{
+    if (!has_last_beat || beat_interval == 0.0)
+        return false;
+
+    double beats_ahead = std::floor((time - last_beat_time) / beat_interval) + 1.0;
+    beat_time = last_beat_time + std::max(beats_ahead, 1.0) * beat_interval;
+    return true;
+}
+
+double BeatEventDetector::tempo() const
+{
+    return beat_interval > 0.0 ? 60.0 / beat_interval : 0.0;
+}
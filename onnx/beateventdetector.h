@@ -0,0 +1,49 @@
+#ifndef BEAT_EVENT_DETECTOR_H
+#define BEAT_EVENT_DETECTOR_H
+
+// A beat or downbeat reported by BeatNet::process.
+// sample is relative to the first sample of the block passed to process(), in host samples.
+// Since the network needs to see a beat before it can report it, events usually lie in the past (sample < 0).
+struct BeatEvent {
+    long long sample;
+    float activation;
+    bool downbeat;
+};
+
+// Causal peak picker on the beat/downbeat activations of the network.
+// Works on stream time in seconds, so that it is independent of the host sample rate.
+class BeatEventDetector {
+public:
+    BeatEventDetector(float threshold = 0.4f, double min_bpm = 55.0, double max_bpm = 215.0);
+
+    void reset();
+
+    // Feeds the activations of the frame centred at `time`. A peak can only be confirmed once the
+    // activation starts to decay, so the detected beat (if any) belongs to the previous frame.
+    bool process(float beat, float downbeat, double time, double& beat_time, float& activation, bool& is_downbeat);
+
+    // Extrapolates the last detected beat with the current tempo estimate and returns the first beat after `time`.
+    bool predictNextBeat(double time, double& beat_time) const;
+
+    // current tempo estimate in beats per minute, 0 if not known yet
+    double tempo() const;
+
+private:
+    float threshold;
+    double min_interval;
+    double max_interval;
+
+    float prev_activation;
+    float prev_beat;
+    float prev_downbeat;
+    double prev_time;
+    bool rising;
+
+    bool has_last_beat;
+    double last_beat_time;
+    double beat_interval;
+
+    void updateTempo(double interval);
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "beatmetrics.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+std::vector<double> BeatMetrics::trim(const std::vector<double>& beats, double min_time)
+{
+    std::vector<double> trimmed;
+    for (double beat : beats)
+        if (beat >= min_time)
+            trimmed.push_back(beat);
+    return trimmed;
+}
+
+double BeatMetrics::fMeasure(const std::vector<double>& annotations, const std::vector<double>& detections, double window)
+{
+    if (annotations.empty() || detections.empty())
+        return 0.0;
+
+    // both lists are sorted and every match window has the same width, so matching greedily from the
+    // start finds a maximum one-to-one matching
+    size_t matches = 0;
+    size_t a = 0, d = 0;
+    while (a < annotations.size() && d < detections.size()) {
+        double difference = detections[d] - annotations[a];
+        if (std::abs(difference) <= window) {
+            matches++;
+            a++;
+            d++;
+        } else if (difference < 0.0) {
+            d++;
+        } else {
+            a++;
+        }
+    }
+
+    double precision = static_cast<double>(matches) / detections.size();
+    double recall = static_cast<double>(matches) / annotations.size();
+    return precision + recall > 0.0 ? 2.0 * precision * recall / (precision + recall) : 0.0;
+}
+
+namespace {
+    // continuous and total accuracy against one variation of the annotations (mir_eval.beat.continuity)
+    void continuityAgainst(const std::vector<double>& reference, const std::vector<double>& estimated,
+                           double phase_threshold, double period_threshold, double& continuous, double& total)
+    {
+        const size_t length = std::max(reference.size(), estimated.size());
+        std::vector<bool> used(reference.size(), false);
+        std::vector<bool> success(length, false);
+
+        for (size_t m = 0; m < estimated.size(); ++m) {
+            size_t nearest = 0;
+            for (size_t i = 1; i < reference.size(); ++i)
+                if (std::abs(estimated[m] - reference[i]) < std::abs(estimated[m] - reference[nearest]))
+                    nearest = i;
+            if (used[nearest])
+                continue;
+            double difference = std::abs(estimated[m] - reference[nearest]);
+
+            double reference_interval, estimated_interval;
+            if (m == 0 || nearest == 0) {
+                // look forward at the start
+                reference_interval = nearest + 1 < reference.size() ? reference[nearest + 1] - reference[nearest]
+                                                                     : reference[nearest] - reference[nearest - 1];
+                estimated_interval = m + 1 < estimated.size() ? estimated[m + 1] - estimated[m]
+                                                              : estimated[m] - estimated[m - 1];
+            } else {
+                reference_interval = reference[nearest] - reference[nearest - 1];
+                estimated_interval = estimated[m] - estimated[m - 1];
+            }
+            double phase = reference_interval == 0.0 ? std::numeric_limits<double>::infinity() : difference / reference_interval;
+            double period = reference_interval == 0.0 ? std::numeric_limits<double>::infinity()
+                                                      : std::abs(1.0 - estimated_interval / reference_interval);
+            if (phase < phase_threshold && period < period_threshold) {
+                used[nearest] = true;
+                success[m] = true;
+            }
+        }
+
+        size_t longest = 0, run = 0, correct = 0;
+        for (bool matched : success) {
+            run = matched ? run + 1 : 0;
+            longest = std::max(longest, run);
+            correct += matched ? 1 : 0;
+        }
+        continuous = static_cast<double>(longest) / length;
+        total = static_cast<double>(correct) / length;
+    }
+}
+
+BeatMetrics::Continuity BeatMetrics::continuity(const std::vector<double>& annotations, const std::vector<double>& detections,
+                                                double phase_threshold, double period_threshold)
+{
+    Continuity result { 0.0, 0.0, 0.0, 0.0 };
+    if (annotations.size() < 2 || detections.size() < 2)
+        return result;
+
+    // annotations at the correct level, then off-beat, double tempo, half tempo odd and half tempo even
+    std::vector<double> doubled;
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        doubled.push_back(annotations[i]);
+        if (i + 1 < annotations.size())
+            doubled.push_back(0.5 * (annotations[i] + annotations[i + 1]));
+    }
+    std::vector<std::vector<double>> variations(5);
+    variations[0] = annotations;
+    for (size_t i = 1; i < doubled.size(); i += 2)
+        variations[1].push_back(doubled[i]);
+    variations[2] = doubled;
+    for (size_t i = 0; i < annotations.size(); ++i)
+        variations[3 + i % 2].push_back(annotations[i]);
+
+    for (size_t v = 0; v < variations.size(); ++v) {
+        if (variations[v].size() < 2)
+            continue;
+        double continuous, total;
+        continuityAgainst(variations[v], detections, phase_threshold, period_threshold, continuous, total);
+        if (v == 0) {
+            result.cmlc = continuous;
+            result.cmlt = total;
+        }
+        result.amlc = std::max(result.amlc, continuous);
+        result.amlt = std::max(result.amlt, total);
+    }
+    return result;
+}
+
+bool BeatMetrics::tempoMatches(double estimate, double reference, double tolerance, bool allow_octave)
+{
+    if (reference <= 0.0)
+        return false;
+    const double factors[] = { 1.0, 2.0, 0.5, 3.0, 1.0 / 3.0 };
+    for (double factor : factors) {
+        if (std::abs(estimate - reference * factor) <= tolerance * reference * factor)
+            return true;
+        if (!allow_octave)
+            break;
+    }
+    return false;
+}
+
+double BeatMetrics::annotatedTempo(const std::vector<double>& annotations)
+{
+    if (annotations.size() < 2)
+        return 0.0;
+    std::vector<double> intervals;
+    for (size_t i = 1; i < annotations.size(); ++i)
+        intervals.push_back(annotations[i] - annotations[i - 1]);
+    std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+    double median = intervals[intervals.size() / 2];
+    return median > 0.0 ? 60.0 / median : 0.0;
+}
+
+BeatMetrics::ActivationError BeatMetrics::compareActivations(const std::vector<float>& reference, const std::vector<float>& actual,
+                                                             int num_classes, int max_lag)
+{
+    ActivationError best { 0, 0.0, std::numeric_limits<double>::infinity(), 0 };
+    const long long reference_frames = static_cast<long long>(reference.size()) / num_classes;
+    const long long actual_frames = static_cast<long long>(actual.size()) / num_classes;
+
+    for (int lag = -max_lag; lag <= max_lag; ++lag) {
+        // actual frame i + lag is compared to reference frame i
+        long long first = std::max(0LL, -static_cast<long long>(lag));
+        long long last = std::min(reference_frames, actual_frames - lag);
+        if (last <= first)
+            continue;
+        double max_error = 0.0, sum = 0.0;
+        for (long long frame = first; frame < last; ++frame) {
+            for (int c = 0; c < num_classes; ++c) {
+                double error = std::abs(reference[frame * num_classes + c] - actual[(frame + lag) * num_classes + c]);
+                max_error = std::max(max_error, error);
+                sum += error;
+            }
+        }
+        double mean = sum / ((last - first) * num_classes);
+        if (mean < best.mean_error)
+            best = { lag, max_error, mean, last - first };
+    }
+    if (best.frames == 0)
+        best.mean_error = 0.0;
+    return best;
+}
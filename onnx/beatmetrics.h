@@ -0,0 +1,43 @@
+#ifndef BEAT_METRICS_H
+#define BEAT_METRICS_H
+
+#include <vector>
+
+// Standard beat tracking evaluation measures, following the definitions (and defaults) of mir_eval.beat,
+// so that the numbers are comparable to the ones reported for BeatNet on Ballroom, GTZAN and Rock corpus.
+// Beat times are in seconds and sorted.
+class BeatMetrics {
+public:
+    struct Continuity {
+        double cmlc;    // longest continuous segment at the correct metrical level
+        double cmlt;    // all correct beats at the correct metrical level
+        double amlc;    // as cmlc, allowing double/half tempo and off-beat
+        double amlt;
+    };
+
+    // mir_eval ignores the first 5 s, where trackers are still settling
+    static std::vector<double> trim(const std::vector<double>& beats, double min_time = 5.0);
+
+    // one-to-one matches within +-window seconds
+    static double fMeasure(const std::vector<double>& annotations, const std::vector<double>& detections, double window = 0.07);
+    static Continuity continuity(const std::vector<double>& annotations, const std::vector<double>& detections,
+                                 double phase_threshold = 0.175, double period_threshold = 0.175);
+
+    // estimate within tolerance (relative) of the reference; allow_octave also accepts double, half, triple and third
+    static bool tempoMatches(double estimate, double reference, double tolerance = 0.04, bool allow_octave = false);
+    // median inter-beat interval of the annotations, in BPM
+    static double annotatedTempo(const std::vector<double>& annotations);
+
+    struct ActivationError {
+        int lag;            // frames the actual activations are shifted by against the reference
+        double max_error;
+        double mean_error;
+        long long frames;   // frames compared
+    };
+    // Compares [frames, num_classes] activation rows at the lag in [-max_lag, max_lag] with the smallest mean error,
+    // since framing at the start of the signal may differ by a hop between implementations.
+    static ActivationError compareActivations(const std::vector<float>& reference, const std::vector<float>& actual,
+                                              int num_classes = 3, int max_lag = 2);
+};
+
+#endif
@@ -0,0 +1,798 @@
+// beatnetd: keeps BeatNet sessions warm and serves beat tracking to local clients over a UNIX socket.
+// The wire format is described in beatnetprotocol.h.
+//
+// One thread runs the epoll loop (accepting, reading and writing sockets), a few worker threads run the
+// trackers. Every client is pinned to one worker, so its hello and blocks are processed in order, and a
+// worker handles everything that queued up for it in one wakeup. The loop stops reading a client while
+// too much of its input waits for the worker.
+
+#include "BeatNet.h"
+#include "beatnetprotocol.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <csignal>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace BeatNetProtocol;
+
+namespace {
+
+    constexpr size_t MAX_PENDING_OUTPUT = 8u << 20;    // a client not reading its results is dropped beyond this
+    constexpr size_t MAX_PENDING_INPUT = 4u << 20;     // reading a client pauses while more than this is queued
+    constexpr uint32_t MAX_CHANNELS = 64;
+    constexpr uint32_t MAX_RING_FRAMES = 1u << 22;
+
+    std::atomic<bool> running { true };
+
+    void handleSignal(int)
+    {
+        running = false;
+    }
+
+    struct Options {
+        std::string socket_path = DEFAULT_SOCKET_PATH;
+        std::string model_path;
+        int workers = 2;
+        int warm_sessions = 4;
+        ThreadConfig thread_config;         // of every tracker
+        ThreadPlacement worker_placement;   // of the worker threads, which also run the model's first intra-op thread
+    };
+
+    // Trackers are expensive to create (ORT session, model load), so a few are kept ready.
+    // A tracker carries the history of the stream it analysed, so it is not reused after its client leaves.
+    class TrackerPool {
+    public:
+        TrackerPool(const std::string& model_path, const ThreadConfig& thread_config, int warm_sessions)
+            : model_path(model_path), thread_config(thread_config), warm_sessions(warm_sessions)
+        {
+            for (int i = 0; i < warm_sessions; ++i)
+                spare.push_back(std::make_unique<BeatNet>(model_path, thread_config));
+            refill_thread = std::thread(&TrackerPool::refill, this);
+        }
+
+        ~TrackerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            refill_thread.join();
+        }
+
+        std::unique_ptr<BeatNet> acquire()
+        {
+            std::unique_ptr<BeatNet> tracker;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!spare.empty()) {
+                    tracker = std::move(spare.back());
+                    spare.pop_back();
+                }
+            }
+            wakeup.notify_one();
+            return tracker ? std::move(tracker) : std::make_unique<BeatNet>(model_path, thread_config);
+        }
+
+    private:
+        void refill()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping) {
+                if (static_cast<int>(spare.size()) >= warm_sessions) {
+                    wakeup.wait(lock);
+                    continue;
+                }
+                lock.unlock();
+                auto tracker = std::make_unique<BeatNet>(model_path, thread_config);
+                lock.lock();
+                spare.push_back(std::move(tracker));
+            }
+        }
+
+        std::string model_path;
+        ThreadConfig thread_config;
+        int warm_sessions;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::vector<std::unique_ptr<BeatNet>> spare;
+        bool stopping = false;
+        std::thread refill_thread;
+    };
+
+    struct Client {
+        int fd = -1;                        // closed by the loop thread under output_mutex, -1 once closed
+        bool greeted = false;               // hello accepted and queued, loop thread only
+        Hello hello {};
+        int worker = 0;
+        std::vector<uint8_t> input;         // bytes of incomplete messages, loop thread only
+        bool want_read = true;              // EPOLLIN registered, loop thread only
+        bool want_write = false;            // EPOLLOUT registered, loop thread only
+        std::atomic<size_t> queued_input { 0 };   // bytes of jobs the worker has not processed yet
+        std::atomic<bool> failed { false }; // set by the worker, the client is dropped once its output is flushed
+
+        std::mutex output_mutex;
+        std::vector<uint8_t> output;        // messages waiting to be sent
+
+        // worker thread only, after the hello; no tracker if the hello failed
+        std::unique_ptr<BeatNet> tracker;
+        uint64_t frames_processed = 0;
+        std::vector<float> block_output = std::vector<float>(3);
+        std::vector<BeatEvent> events;
+        std::vector<float> activations;
+        std::vector<uint8_t> message;
+
+        SharedRing* ring = nullptr;
+        size_t ring_bytes = 0;
+
+        ~Client()
+        {
+            if (ring)
+                munmap(ring, ring_bytes);
+        }
+    };
+
+    struct Job {
+        std::shared_ptr<Client> client;
+        bool hello = false;                 // Hello: set up the tracker and send the ack
+        std::vector<float> pcm;             // Audio: interleaved samples
+        uint32_t shm_frames = 0;            // AudioShm: frames to take from the ring
+        size_t input_bytes = 0;             // counted in the client's queued_input
+    };
+
+    void appendMessage(std::vector<uint8_t>& buffer, MessageType type, const void* payload, uint32_t size)
+    {
+        MessageHeader header { MAGIC, static_cast<uint16_t>(type), VERSION, size };
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(header));
+        bytes = static_cast<const uint8_t*>(payload);
+        if (size)
+            buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    class Daemon;
+
+    class Worker {
+    public:
+        Worker(Daemon& daemon, const ThreadPlacement& placement) : daemon(daemon), placement(placement) { }
+
+        void start() { thread = std::thread(&Worker::run, this); }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_one();
+            if (thread.joinable())
+                thread.join();
+        }
+
+        void push(Job&& job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(std::move(job));
+            }
+            wakeup.notify_one();
+        }
+
+    private:
+        void run();
+        void greet(Client& client);
+        void fail(Client& client, const char* text);
+        void process(Client& client, const float* interleaved, uint32_t num_frames);
+
+        Daemon& daemon;
+        ThreadPlacement placement;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::vector<Job> queue;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    class Daemon {
+    public:
+        explicit Daemon(const Options& options)
+            : options(options), pool(options.model_path, options.thread_config, options.warm_sessions)
+        {
+            for (int i = 0; i < std::max(1, options.workers); ++i)
+                workers.push_back(std::make_unique<Worker>(*this, options.worker_placement));
+        }
+
+        ~Daemon()
+        {
+            for (auto& worker : workers)
+                worker->stop();
+            for (auto& entry : clients)
+                close(entry.first);
+            if (listen_fd >= 0) {
+                close(listen_fd);
+                unlink(options.socket_path.c_str());
+            }
+            if (event_fd >= 0)
+                close(event_fd);
+            if (epoll_fd >= 0)
+                close(epoll_fd);
+        }
+
+        bool open();
+        void run();
+
+        // called by the workers; may load a model if no warm tracker is left
+        std::unique_ptr<BeatNet> acquireTracker() { return pool.acquire(); }
+
+        // called by the workers once a client has new output, failed or drained its queued input
+        void markDirty(const std::shared_ptr<Client>& client)
+        {
+            {
+                std::lock_guard<std::mutex> lock(dirty_mutex);
+                dirty.push_back(client);
+            }
+            uint64_t one = 1;
+            (void)!write(event_fd, &one, sizeof(one));
+        }
+
+    private:
+        void accept();
+        void read(const std::shared_ptr<Client>& client);
+        bool handleInput(const std::shared_ptr<Client>& client);
+        bool handleMessage(const std::shared_ptr<Client>& client, const MessageHeader& header, const uint8_t* payload);
+        bool greet(const std::shared_ptr<Client>& client, const Hello& hello);
+        void sendError(const std::shared_ptr<Client>& client, const char* text);
+        void flush(const std::shared_ptr<Client>& client);
+        void watch(const std::shared_ptr<Client>& client, bool want_write);
+        void flushDirty();
+        void drop(const std::shared_ptr<Client>& client);
+
+        Options options;
+        TrackerPool pool;
+        std::vector<std::unique_ptr<Worker>> workers;
+        int next_worker = 0;
+
+        int listen_fd = -1;
+        int epoll_fd = -1;
+        int event_fd = -1;
+        std::unordered_map<int, std::shared_ptr<Client>> clients;
+
+        std::mutex dirty_mutex;
+        std::vector<std::shared_ptr<Client>> dirty;
+    };
+
+    void Worker::run()
+    {
+        applyThreadPlacement(placement);
+        std::vector<Job> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                batch.swap(queue);
+            }
+
+            for (Job& job : batch) {
+                Client& client = *job.client;
+                const uint32_t channels = client.hello.num_channels;
+                if (job.hello) {
+                    greet(client);
+                } else if (!client.tracker) {
+                    // the hello failed, the client is on its way out
+                } else if (job.shm_frames == 0) {
+                    process(client, job.pcm.data(), static_cast<uint32_t>(job.pcm.size() / channels));
+                } else if (client.ring) {
+                    // the header lives in memory the client can write to, so the capacity is taken from the hello
+                    SharedRing& ring = *client.ring;
+                    const uint32_t ring_frames = client.hello.ring_frames;
+                    const float* data = reinterpret_cast<const float*>(&ring + 1);
+                    uint64_t read_frame = ring.read_frame.load(std::memory_order_relaxed);
+                    uint64_t available = ring.write_frame.load(std::memory_order_acquire) - read_frame;
+                    uint32_t remaining = static_cast<uint32_t>(std::min<uint64_t>({ job.shm_frames, available, ring_frames }));
+                    // at most two contiguous segments, the second one after the wrap
+                    while (remaining > 0) {
+                        uint32_t first = static_cast<uint32_t>(read_frame % ring_frames);
+                        uint32_t frames = std::min(remaining, ring_frames - first);
+                        process(client, data + static_cast<size_t>(first) * channels, frames);
+                        read_frame += frames;
+                        remaining -= frames;
+                    }
+                    ring.read_frame.store(read_frame, std::memory_order_release);
+                }
+                client.queued_input.fetch_sub(job.input_bytes, std::memory_order_relaxed);
+                daemon.markDirty(job.client);
+            }
+            batch.clear();
+        }
+    }
+
+    // Taking a tracker from the pool may have to load a model, and setup() configures the resampler, so this
+    // runs on the client's worker rather than on the loop thread. Nothing else has been sent to the client yet,
+    // so the ack goes out directly; the shared memory fd has to travel with it.
+    void Worker::greet(Client& client)
+    {
+        const Hello& hello = client.hello;
+        client.tracker = daemon.acquireTracker();
+        if (!client.tracker->setup(hello.sample_rate, static_cast<int>(hello.block_size))) {
+            fail(client, "tracker setup failed");
+            return;
+        }
+
+        HelloAck ack { 0, 0 };
+        int memory_fd = -1;
+        if (hello.flags & UseSharedMemory) {
+            ack.ring_bytes = ringBytes(hello.ring_frames, hello.num_channels);
+            memory_fd = memfd_create("beatnetd-ring", MFD_CLOEXEC);
+            void* memory = MAP_FAILED;
+            if (memory_fd >= 0 && ftruncate(memory_fd, ack.ring_bytes) == 0)
+                memory = mmap(nullptr, ack.ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+            if (memory == MAP_FAILED) {
+                if (memory_fd >= 0)
+                    close(memory_fd);
+                fail(client, "cannot create the shared ring");
+                return;
+            }
+            client.ring = new (memory) SharedRing();
+            client.ring->ring_frames = hello.ring_frames;
+            client.ring->num_channels = hello.num_channels;
+            client.ring_bytes = ack.ring_bytes;
+        }
+
+        std::vector<uint8_t> message;
+        appendMessage(message, MessageType::HelloAck, &ack, sizeof(ack));
+        iovec vector { message.data(), message.size() };
+        msghdr header {};
+        header.msg_iov = &vector;
+        header.msg_iovlen = 1;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        if (memory_fd >= 0) {
+            header.msg_control = control;
+            header.msg_controllen = sizeof(control);
+            cmsghdr* message_control = CMSG_FIRSTHDR(&header);
+            message_control->cmsg_level = SOL_SOCKET;
+            message_control->cmsg_type = SCM_RIGHTS;
+            message_control->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(message_control), &memory_fd, sizeof(int));
+        }
+        bool sent;
+        {
+            // holding the lock keeps the loop thread from closing the socket meanwhile
+            std::lock_guard<std::mutex> lock(client.output_mutex);
+            sent = client.fd >= 0 && sendmsg(client.fd, &header, MSG_NOSIGNAL | MSG_DONTWAIT) == static_cast<ssize_t>(message.size());
+        }
+        if (memory_fd >= 0)
+            close(memory_fd);
+        if (!sent) {
+            client.tracker.reset();
+            client.failed = true;
+        }
+    }
+
+    // queues the error for the loop thread, which drops the client after sending it
+    void Worker::fail(Client& client, const char* text)
+    {
+        client.tracker.reset();
+        {
+            std::lock_guard<std::mutex> lock(client.output_mutex);
+            appendMessage(client.output, MessageType::Error, text, static_cast<uint32_t>(std::strlen(text)));
+        }
+        client.failed = true;
+    }
+
+    void Worker::process(Client& client, const float* interleaved, uint32_t num_frames)
+    {
+        const uint32_t channels = client.hello.num_channels;
+        const uint32_t block_size = client.hello.block_size;
+        const bool want_activations = client.hello.flags & WantActivations;
+
+        for (uint32_t offset = 0; offset < num_frames; offset += block_size) {
+            uint32_t frames = std::min(block_size, num_frames - offset);
+            client.activations.clear();
+            client.tracker->process(interleaved + static_cast<size_t>(offset) * channels, static_cast<int>(channels),
+                                    static_cast<int>(frames), client.block_output, client.events, client.activations);
+
+            ResultHeader result { client.frames_processed, static_cast<uint32_t>(client.events.size()),
+                                  want_activations ? static_cast<uint32_t>(client.activations.size() / 3) : 0u };
+            client.message.clear();
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&result);
+            client.message.insert(client.message.end(), bytes, bytes + sizeof(result));
+            for (const BeatEvent& event : client.events) {
+                BeatEventRecord record { static_cast<int64_t>(client.frames_processed) + event.sample, event.activation,
+                                         event.downbeat ? 1u : 0u };
+                bytes = reinterpret_cast<const uint8_t*>(&record);
+                client.message.insert(client.message.end(), bytes, bytes + sizeof(record));
+            }
+            if (result.num_hops) {
+                bytes = reinterpret_cast<const uint8_t*>(client.activations.data());
+                client.message.insert(client.message.end(), bytes, bytes + sizeof(float) * 3 * result.num_hops);
+            }
+            client.frames_processed += frames;
+
+            std::lock_guard<std::mutex> lock(client.output_mutex);
+            appendMessage(client.output, MessageType::Result, client.message.data(), static_cast<uint32_t>(client.message.size()));
+        }
+    }
+
+    bool Daemon::open()
+    {
+        if (options.socket_path.size() >= sizeof(sockaddr_un::sun_path)) {
+            std::cerr << "beatnetd: socket path too long: " << options.socket_path << std::endl;
+            return false;
+        }
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+            std::cerr << "beatnetd: socket() failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, options.socket_path.c_str());
+        unlink(options.socket_path.c_str());
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+            std::cerr << "beatnetd: cannot listen on " << options.socket_path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd < 0 || event_fd < 0) {
+            std::cerr << "beatnetd: cannot create the event loop: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = listen_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+        event.data.fd = event_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &event);
+
+        for (auto& worker : workers)
+            worker->start();
+        return true;
+    }
+
+    void Daemon::run()
+    {
+        std::vector<epoll_event> events(64);
+        while (running) {
+            int count = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 500);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::cerr << "beatnetd: epoll_wait failed: " << std::strerror(errno) << std::endl;
+                return;
+            }
+            for (int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd) {
+                    accept();
+                    continue;
+                }
+                if (fd == event_fd) {
+                    uint64_t value;
+                    (void)!::read(event_fd, &value, sizeof(value));
+                    flushDirty();
+                    continue;
+                }
+                auto found = clients.find(fd);
+                if (found == clients.end())
+                    continue;
+                std::shared_ptr<Client> client = found->second;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    drop(client);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT)
+                    flush(client);
+                if (client->fd >= 0 && events[i].events & EPOLLIN)
+                    read(client);
+            }
+        }
+    }
+
+    void Daemon::accept()
+    {
+        for (;;) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    std::cerr << "beatnetd: accept failed: " << std::strerror(errno) << std::endl;
+                return;
+            }
+            auto client = std::make_shared<Client>();
+            client->fd = fd;
+            epoll_event event {};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            clients[fd] = std::move(client);
+        }
+    }
+
+    void Daemon::read(const std::shared_ptr<Client>& client)
+    {
+        uint8_t buffer[64 * 1024];
+        // stops early once the worker is behind on this client, flush() resumes reading when it has caught up
+        while (client->queued_input.load(std::memory_order_relaxed) <= MAX_PENDING_INPUT) {
+            ssize_t received = recv(client->fd, buffer, sizeof(buffer), 0);
+            if (received == 0) {
+                drop(client);
+                return;
+            }
+            if (received < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    drop(client);
+                    return;
+                }
+                break;
+            }
+            client->input.insert(client->input.end(), buffer, buffer + received);
+            if (!handleInput(client))
+                return;
+        }
+        watch(client, client->want_write);
+    }
+
+    // handles the complete messages in the input buffer; false if the client was dropped
+    bool Daemon::handleInput(const std::shared_ptr<Client>& client)
+    {
+        size_t offset = 0;
+        while (client->input.size() - offset >= sizeof(MessageHeader)) {
+            MessageHeader header;
+            std::memcpy(&header, client->input.data() + offset, sizeof(header));
+            if (header.magic != MAGIC || header.version != VERSION || header.payload_size > MAX_PAYLOAD_SIZE) {
+                sendError(client, "malformed message header");
+                drop(client);
+                return false;
+            }
+            if (client->input.size() - offset < sizeof(header) + header.payload_size)
+                break;
+            if (!handleMessage(client, header, client->input.data() + offset + sizeof(header))) {
+                drop(client);
+                return false;
+            }
+            offset += sizeof(header) + header.payload_size;
+        }
+        client->input.erase(client->input.begin(), client->input.begin() + offset);
+        return true;
+    }
+
+    bool Daemon::handleMessage(const std::shared_ptr<Client>& client, const MessageHeader& header, const uint8_t* payload)
+    {
+        switch (static_cast<MessageType>(header.type)) {
+            case MessageType::Hello: {
+                if (client->greeted || header.payload_size != sizeof(Hello)) {
+                    sendError(client, "unexpected hello");
+                    return false;
+                }
+                Hello hello;
+                std::memcpy(&hello, payload, sizeof(hello));
+                return greet(client, hello);
+            }
+            case MessageType::Audio: {
+                const size_t frame_bytes = sizeof(float) * client->hello.num_channels;
+                if (!client->greeted || header.payload_size % frame_bytes != 0) {
+                    sendError(client, "unexpected audio");
+                    return false;
+                }
+                Job job;
+                job.client = client;
+                job.pcm.resize(header.payload_size / sizeof(float));
+                std::memcpy(job.pcm.data(), payload, header.payload_size);
+                job.input_bytes = sizeof(Job) + header.payload_size;
+                client->queued_input.fetch_add(job.input_bytes, std::memory_order_relaxed);
+                workers[client->worker]->push(std::move(job));
+                return true;
+            }
+            case MessageType::AudioShm: {
+                if (!client->greeted || !(client->hello.flags & UseSharedMemory) || header.payload_size != sizeof(AudioShm)) {
+                    sendError(client, "unexpected shared memory audio");
+                    return false;
+                }
+                AudioShm audio;
+                std::memcpy(&audio, payload, sizeof(audio));
+                if (audio.num_frames) {
+                    Job job;
+                    job.client = client;
+                    job.shm_frames = audio.num_frames;
+                    job.input_bytes = sizeof(Job);
+                    client->queued_input.fetch_add(job.input_bytes, std::memory_order_relaxed);
+                    workers[client->worker]->push(std::move(job));
+                }
+                return true;
+            }
+            case MessageType::Bye:
+                return false;
+            default:
+                sendError(client, "unknown message type");
+                return false;
+        }
+    }
+
+    // checks the parameters and hands the hello to the client's worker, see Worker::greet
+    bool Daemon::greet(const std::shared_ptr<Client>& client, const Hello& hello)
+    {
+        const bool shared = hello.flags & UseSharedMemory;
+        if (hello.sample_rate <= 0.0 || hello.block_size == 0 || hello.block_size > MAX_PAYLOAD_SIZE / sizeof(float)
+            || hello.num_channels == 0 || hello.num_channels > MAX_CHANNELS
+            || (shared && (hello.ring_frames == 0 || hello.ring_frames > MAX_RING_FRAMES))) {
+            sendError(client, "invalid stream parameters");
+            return false;
+        }
+
+        client->hello = hello;
+        client->worker = next_worker;
+        next_worker = (next_worker + 1) % static_cast<int>(workers.size());
+        client->greeted = true;
+        Job job;
+        job.client = client;
+        job.hello = true;
+        workers[client->worker]->push(std::move(job));
+        return true;
+    }
+
+    void Daemon::sendError(const std::shared_ptr<Client>& client, const char* text)
+    {
+        std::vector<uint8_t> message;
+        appendMessage(message, MessageType::Error, text, static_cast<uint32_t>(std::strlen(text)));
+        // best effort, the client is dropped right after; the lock keeps it apart from a hello ack being sent
+        std::lock_guard<std::mutex> lock(client->output_mutex);
+        (void)!send(client->fd, message.data(), message.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+
+    void Daemon::flush(const std::shared_ptr<Client>& client)
+    {
+        if (client->fd < 0)
+            return;
+
+        bool failed = false;
+        bool pending;
+        {
+            std::lock_guard<std::mutex> lock(client->output_mutex);
+            size_t offset = 0;
+            while (offset < client->output.size()) {
+                ssize_t sent = send(client->fd, client->output.data() + offset, client->output.size() - offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (sent < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    failed = errno != EAGAIN && errno != EWOULDBLOCK;
+                    break;
+                }
+                offset += static_cast<size_t>(sent);
+            }
+            client->output.erase(client->output.begin(), client->output.begin() + offset);
+            pending = !client->output.empty();
+            if (client->output.size() > MAX_PENDING_OUTPUT) {
+                std::cerr << "beatnetd: dropping a client that does not read its results" << std::endl;
+                failed = true;
+            }
+        }
+        if (failed || client->failed) {
+            drop(client);
+            return;
+        }
+        watch(client, pending);
+    }
+
+    // registers the events the client needs: output if some is pending, input unless its worker is behind.
+    // EPOLLRDHUP goes with EPOLLIN, a paused client that hung up is noticed once reading resumes.
+    void Daemon::watch(const std::shared_ptr<Client>& client, bool want_write)
+    {
+        const bool want_read = client->queued_input.load(std::memory_order_relaxed) <= MAX_PENDING_INPUT;
+        if (want_read == client->want_read && want_write == client->want_write)
+            return;
+        client->want_read = want_read;
+        client->want_write = want_write;
+        epoll_event event {};
+        event.events = (want_read ? EPOLLIN | EPOLLRDHUP : 0u) | (want_write ? EPOLLOUT : 0u);
+        event.data.fd = client->fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+    }
+
+    void Daemon::flushDirty()
+    {
+        std::vector<std::shared_ptr<Client>> ready;
+        {
+            std::lock_guard<std::mutex> lock(dirty_mutex);
+            ready.swap(dirty);
+        }
+        for (const auto& client : ready)
+            flush(client);
+    }
+
+    void Daemon::drop(const std::shared_ptr<Client>& client)
+    {
+        if (client->fd < 0)
+            return;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, nullptr);
+        clients.erase(client->fd);
+        // queued jobs still hold the client, it (and its tracker) goes away with the last of them
+        std::lock_guard<std::mutex> lock(client->output_mutex);
+        close(client->fd);
+        client->fd = -1;
+    }
+
+    void printUsage()
+    {
+        std::cerr << "usage: beatnetd [--socket PATH] [--model PATH] [--workers N] [--warm N]\n"
+                     "                [--worker-cores LIST] [--inference-cores LIST] [--intra-op-threads N]\n"
+                     "                [--realtime PRIORITY] [--no-spin]\n"
+                     "CPU lists as for taskset, e.g. 2,3 or 4-7. --realtime runs the workers and inference\n"
+                     "threads with SCHED_FIFO, falling back to normal scheduling without the privilege.\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--no-spin") {
+            options.thread_config.allow_spinning = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        if (argument == "--socket")
+            options.socket_path = argv[++i];
+        else if (argument == "--model")
+            options.model_path = argv[++i];
+        else if (argument == "--workers")
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--warm")
+            options.warm_sessions = std::max(0, std::atoi(argv[++i]));
+        else if (argument == "--worker-cores")
+            options.worker_placement.cores = parseCoreList(argv[++i]);
+        else if (argument == "--inference-cores")
+            options.thread_config.inference.cores = parseCoreList(argv[++i]);
+        else if (argument == "--intra-op-threads")
+            options.thread_config.intra_op_threads = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--realtime") {
+            int priority = std::atoi(argv[++i]);
+            for (ThreadPlacement* placement : { &options.worker_placement, &options.thread_config.inference }) {
+                placement->policy = SchedulingPolicy::Fifo;
+                placement->priority = priority;
+            }
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Daemon daemon(options);
+    if (!daemon.open())
+        return 1;
+    std::cout << "beatnetd listening on " << options.socket_path << std::endl;
+    daemon.run();
+    return 0;
+}
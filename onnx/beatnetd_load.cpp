@@ -0,0 +1,419 @@
+// beatnetd_load: load test for beatnetd. Opens N concurrent client connections, streams a click track over
+// each one and reports the latency from sending an Audio block to receiving its Result, as percentiles over
+// all blocks of all clients, and the throughput the daemon sustained.
+//
+// Every client runs on its own thread with blocking sockets and keeps one block in flight. All clients say
+// hello first, then start streaming together, staggered over one block duration so that they do not all
+// send at the same instant. By default the blocks are paced at real time, as a live input would deliver
+// them; --unpaced sends the next block as soon as the previous result is in. --shm runs every client count
+// a second time with the audio going through the shared ring (UseSharedMemory) instead of the socket.
+
+#include "beatnetprotocol.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace BeatNetProtocol;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string socket_path = DEFAULT_SOCKET_PATH;
+        std::vector<int> client_counts { 1, 10, 100, 1000 };
+        double sample_rate = 44100.0;
+        uint32_t block_size = 512;
+        double seconds = 10.0;              // of audio per client
+        bool paced = true;
+        bool shared_memory = false;         // also run every count over the shared ring
+    };
+
+    // the daemon's ring, mapped from the memfd that came with the HelloAck
+    struct MappedRing {
+        SharedRing* ring = nullptr;
+        size_t bytes = 0;
+
+        ~MappedRing()
+        {
+            if (ring)
+                munmap(ring, bytes);
+        }
+    };
+
+    // one run with a given number of clients
+    class LoadRun {
+    public:
+        LoadRun(const Options& options, int num_clients, bool shared_memory)
+            : options(options), num_clients(num_clients), shared_memory(shared_memory) { }
+
+        bool run();
+
+    private:
+        void client(int index);
+        bool connectAndGreet(int& fd, MappedRing& mapped);
+        bool sendShared(int fd, MappedRing& mapped, const std::vector<float>& block);
+        void waitForStart();
+
+        const Options& options;
+        int num_clients;
+        bool shared_memory;
+
+        std::mutex mutex;
+        std::condition_variable start_signal;
+        int ready = 0;                       // clients done with their hello, successful or not
+        int failed = 0;                      // clients that could not connect, were refused or broke off
+        bool started = false;
+        Clock::time_point start_time;
+
+        std::vector<double> latencies;       // in microseconds, of every block of every client
+        long long late_blocks = 0;           // results that arrived after the next block was due
+    };
+
+    bool writeAll(int fd, const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, void* data, size_t size)
+    {
+        uint8_t* bytes = static_cast<uint8_t*>(data);
+        while (size > 0) {
+            ssize_t received = recv(fd, bytes, size, 0);
+            if (received == 0)
+                return false;
+            if (received < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            bytes += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    bool sendMessage(int fd, MessageType type, const void* payload, uint32_t size)
+    {
+        MessageHeader header { MAGIC, static_cast<uint16_t>(type), VERSION, size };
+        return writeAll(fd, &header, sizeof(header)) && (size == 0 || writeAll(fd, payload, size));
+    }
+
+    // reads one message; an Error from the daemon is printed and treated as a failure
+    bool receiveMessage(int fd, MessageType& type, std::vector<uint8_t>& payload)
+    {
+        MessageHeader header;
+        if (!readAll(fd, &header, sizeof(header)))
+            return false;
+        if (header.magic != MAGIC || header.version != VERSION || header.payload_size > MAX_PAYLOAD_SIZE) {
+            std::cerr << "beatnetd_load: malformed message header from the daemon" << std::endl;
+            return false;
+        }
+        payload.resize(header.payload_size);
+        if (header.payload_size && !readAll(fd, payload.data(), header.payload_size))
+            return false;
+        type = static_cast<MessageType>(header.type);
+        if (type == MessageType::Error) {
+            std::cerr << "beatnetd_load: daemon error: " << std::string(payload.begin(), payload.end()) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // reads the HelloAck and, if the daemon attached one, the memfd; an Error is reported as for receiveMessage
+    bool receiveAck(int fd, HelloAck& ack, int& memory_fd)
+    {
+        memory_fd = -1;
+        MessageHeader header;
+        iovec vector { &header, sizeof(header) };
+        msghdr message {};
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t received;
+        do {
+            received = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        } while (received < 0 && errno == EINTR);
+        if (received <= 0)
+            return false;
+        for (cmsghdr* item = CMSG_FIRSTHDR(&message); item; item = CMSG_NXTHDR(&message, item))
+            if (item->cmsg_level == SOL_SOCKET && item->cmsg_type == SCM_RIGHTS)
+                std::memcpy(&memory_fd, CMSG_DATA(item), sizeof(int));
+        if (!readAll(fd, reinterpret_cast<uint8_t*>(&header) + received, sizeof(header) - static_cast<size_t>(received)))
+            return false;
+        if (header.magic != MAGIC || header.version != VERSION || header.payload_size > MAX_PAYLOAD_SIZE) {
+            std::cerr << "beatnetd_load: malformed message header from the daemon" << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> payload(header.payload_size);
+        if (header.payload_size && !readAll(fd, payload.data(), header.payload_size))
+            return false;
+        if (static_cast<MessageType>(header.type) == MessageType::Error) {
+            std::cerr << "beatnetd_load: daemon error: " << std::string(payload.begin(), payload.end()) << std::endl;
+            return false;
+        }
+        if (static_cast<MessageType>(header.type) != MessageType::HelloAck || payload.size() != sizeof(ack))
+            return false;
+        std::memcpy(&ack, payload.data(), sizeof(ack));
+        return true;
+    }
+
+    bool LoadRun::connectAndGreet(int& fd, MappedRing& mapped)
+    {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            std::cerr << "beatnetd_load: socket() failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, options.socket_path.c_str(), sizeof(address.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            std::cerr << "beatnetd_load: cannot connect to " << options.socket_path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // one block in flight, so a few blocks of ring are plenty
+        Hello hello { options.sample_rate, options.block_size, 1, shared_memory ? UseSharedMemory : 0u,
+                      shared_memory ? 4 * options.block_size : 0u };
+        HelloAck ack {};
+        int memory_fd = -1;
+        if (!sendMessage(fd, MessageType::Hello, &hello, sizeof(hello)) || !receiveAck(fd, ack, memory_fd))
+            return false;
+        if (memory_fd >= 0) {
+            void* memory = ack.ring_bytes >= ringBytes(hello.ring_frames, 1)
+                           ? mmap(nullptr, ack.ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0) : MAP_FAILED;
+            close(memory_fd);
+            if (memory == MAP_FAILED) {
+                std::cerr << "beatnetd_load: cannot map the shared ring" << std::endl;
+                return false;
+            }
+            mapped.ring = static_cast<SharedRing*>(memory);
+            mapped.bytes = ack.ring_bytes;
+        }
+        if (shared_memory && !mapped.ring) {
+            std::cerr << "beatnetd_load: the daemon sent no shared ring" << std::endl;
+            return false;
+        }
+        return ack.status == 0;
+    }
+
+    // writes the block behind write_frame, wrapping around the end of the ring, and announces it
+    bool LoadRun::sendShared(int fd, MappedRing& mapped, const std::vector<float>& block)
+    {
+        SharedRing& ring = *mapped.ring;
+        const uint32_t ring_frames = 4 * options.block_size;
+        float* data = reinterpret_cast<float*>(&ring + 1);
+        uint64_t write_frame = ring.write_frame.load(std::memory_order_relaxed);
+        if (write_frame + block.size() - ring.read_frame.load(std::memory_order_acquire) > ring_frames)
+            return false;
+        for (float sample : block)
+            data[write_frame++ % ring_frames] = sample;
+        ring.write_frame.store(write_frame, std::memory_order_release);
+        AudioShm audio { static_cast<uint32_t>(block.size()) };
+        return sendMessage(fd, MessageType::AudioShm, &audio, sizeof(audio));
+    }
+
+    void LoadRun::waitForStart()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        start_signal.wait(lock, [this] { return started; });
+    }
+
+    void LoadRun::client(int index)
+    {
+        int fd = -1;
+        MappedRing mapped;
+        bool ok = connectAndGreet(fd, mapped);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready++;
+        }
+        start_signal.notify_all();
+        waitForStart();
+
+        const long long num_blocks = static_cast<long long>(std::ceil(options.seconds * options.sample_rate / options.block_size));
+        const auto block_duration = std::chrono::duration<double>(options.block_size / options.sample_rate);
+        const long long click_period = static_cast<long long>(options.sample_rate / 2);
+        std::vector<double> client_latencies;
+        client_latencies.reserve(static_cast<size_t>(num_blocks));
+        long long client_late = 0;
+        std::vector<float> block(options.block_size);
+        std::vector<uint8_t> payload;
+
+        auto next_send = start_time + std::chrono::duration_cast<Clock::duration>(block_duration * index / num_clients);
+        for (long long i = 0; ok && i < num_blocks; ++i) {
+            // 120 bpm clicks, as in beatnet_infer
+            for (uint32_t n = 0; n < options.block_size; ++n) {
+                long long phase = (i * options.block_size + n) % click_period;
+                block[n] = phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f;
+            }
+            if (options.paced)
+                std::this_thread::sleep_until(next_send);
+
+            auto sent = Clock::now();
+            MessageType type;
+            ok = (shared_memory ? sendShared(fd, mapped, block)
+                                : sendMessage(fd, MessageType::Audio, block.data(), static_cast<uint32_t>(sizeof(float) * block.size())))
+                 && receiveMessage(fd, type, payload) && type == MessageType::Result;
+            auto received = Clock::now();
+            if (ok)
+                client_latencies.push_back(std::chrono::duration<double, std::micro>(received - sent).count());
+
+            next_send += std::chrono::duration_cast<Clock::duration>(block_duration);
+            if (options.paced && received > next_send)
+                client_late++;
+        }
+
+        if (fd >= 0) {
+            if (ok)
+                sendMessage(fd, MessageType::Bye, nullptr, 0);
+            close(fd);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok)
+            failed++;
+        latencies.insert(latencies.end(), client_latencies.begin(), client_latencies.end());
+        late_blocks += client_late;
+    }
+
+    double percentile(const std::vector<double>& sorted, double fraction)
+    {
+        if (sorted.empty())
+            return 0.0;
+        size_t index = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+        return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+    }
+
+    bool LoadRun::run()
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(num_clients);
+        auto connect_start = Clock::now();
+        for (int i = 0; i < num_clients; ++i)
+            threads.emplace_back(&LoadRun::client, this, i);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_signal.wait(lock, [this] { return ready == num_clients; });
+            start_time = Clock::now();
+            started = true;
+        }
+        start_signal.notify_all();
+        double connect_seconds = std::chrono::duration<double>(start_time - connect_start).count();
+
+        for (std::thread& thread : threads)
+            thread.join();
+        double wall_seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        double audio_seconds = latencies.size() * options.block_size / options.sample_rate;
+        std::cout << num_clients << " clients over the " << (shared_memory ? "shared ring" : "socket") << " (" << failed << " failed, connect and hello " << connect_seconds << " s): "
+                  << latencies.size() << " blocks in " << wall_seconds << " s, "
+                  << latencies.size() / wall_seconds << " blocks/s, " << audio_seconds / wall_seconds << "x real time\n"
+                  << "    latency us p50 " << percentile(latencies, 0.5) << ", p90 " << percentile(latencies, 0.9)
+                  << ", p99 " << percentile(latencies, 0.99) << ", p99.9 " << percentile(latencies, 0.999)
+                  << ", max " << (latencies.empty() ? 0.0 : latencies.back());
+        if (options.paced)
+            std::cout << ", " << late_blocks << " results after the next block was due";
+        std::cout << std::endl;
+        return failed == 0;
+    }
+
+    std::vector<int> parseCounts(const std::string& list)
+    {
+        std::vector<int> counts;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ','))
+            if (std::atoi(item.c_str()) > 0)
+                counts.push_back(std::atoi(item.c_str()));
+        return counts;
+    }
+
+    void printUsage()
+    {
+        std::cerr << "usage: beatnetd_load [--socket PATH] [--clients LIST] [--seconds S] [--rate HZ] [--block FRAMES]\n"
+                     "                     [--unpaced] [--shm]\n"
+                     "--clients is a comma separated list of concurrent client counts to run one after the other\n"
+                     "(default 1,10,100,1000). Every client streams S seconds of mono audio (default 10).\n"
+                     "--shm repeats every count with the audio written to the daemon's shared ring.\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--unpaced") {
+            options.paced = false;
+            continue;
+        }
+        if (argument == "--shm") {
+            options.shared_memory = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        if (argument == "--socket")
+            options.socket_path = argv[++i];
+        else if (argument == "--clients")
+            options.client_counts = parseCounts(argv[++i]);
+        else if (argument == "--seconds")
+            options.seconds = std::max(0.1, std::atof(argv[++i]));
+        else if (argument == "--rate")
+            options.sample_rate = std::max(1000.0, std::atof(argv[++i]));
+        else if (argument == "--block")
+            options.block_size = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (options.client_counts.empty() || options.socket_path.size() >= sizeof(sockaddr_un::sun_path)) {
+        printUsage();
+        return 1;
+    }
+
+    bool passed = true;
+    for (int num_clients : options.client_counts) {
+        LoadRun socket_run(options, num_clients, false);
+        passed = socket_run.run() && passed;
+        if (options.shared_memory) {
+            LoadRun shared_run(options, num_clients, true);
+            passed = shared_run.run() && passed;
+        }
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#ifndef BEATNET_PROTOCOL_H
+#define BEATNET_PROTOCOL_H
+
+#include <atomic>
+#include <cstdint>
+
+// Wire format between beatnetd and its clients, over a UNIX stream socket. Every message is a
+// MessageHeader followed by payload_size bytes. All fields are in host byte order: client and
+// daemon always run on the same machine.
+namespace BeatNetProtocol {
+
+    constexpr uint32_t MAGIC = 0x42544e44; // "BTND"
+    constexpr uint16_t VERSION = 1;
+    constexpr const char* DEFAULT_SOCKET_PATH = "/tmp/beatnetd.sock";
+    constexpr uint32_t MAX_PAYLOAD_SIZE = 16u << 20;
+
+    enum class MessageType : uint16_t {
+        Hello = 1,      // client -> daemon: Hello
+        HelloAck = 2,   // daemon -> client: HelloAck, with the shared memory fd attached (SCM_RIGHTS) if requested
+        Audio = 3,      // client -> daemon: interleaved float32 PCM in the payload
+        AudioShm = 4,   // client -> daemon: AudioShm, the PCM was written to the shared ring
+        Result = 5,     // daemon -> client: ResultHeader, then num_events BeatEventRecord, then num_hops * 3 floats
+        Bye = 6,        // either direction, no payload
+        Error = 7       // daemon -> client: error message text
+    };
+
+    struct MessageHeader {
+        uint32_t magic;
+        uint16_t type;
+        uint16_t version;
+        uint32_t payload_size;
+    };
+
+    enum HelloFlags : uint32_t {
+        WantActivations = 1u << 0,  // send the per-hop activations along with the events
+        UseSharedMemory = 1u << 1   // transfer audio through a shared ring instead of the socket
+    };
+
+    struct Hello {
+        double sample_rate;
+        uint32_t block_size;        // frames per Audio/AudioShm message, larger messages are split
+        uint32_t num_channels;
+        uint32_t flags;
+        uint32_t ring_frames;       // capacity of the shared ring, if UseSharedMemory
+    };
+
+    struct HelloAck {
+        uint32_t status;            // 0 on success
+        uint32_t ring_bytes;        // size of the shared memory to map, 0 without UseSharedMemory
+    };
+
+    // Start of the shared memory block, followed by ring_frames * num_channels floats.
+    // The client owns write_frame, the daemon read_frame; both only ever increase.
+    struct SharedRing {
+        std::atomic<uint64_t> write_frame;
+        std::atomic<uint64_t> read_frame;
+        uint32_t ring_frames;
+        uint32_t num_channels;
+    };
+
+    struct AudioShm {
+        uint32_t num_frames;        // frames made available since the last AudioShm
+    };
+
+    struct ResultHeader {
+        uint64_t block_start;       // stream position of the first frame of the block, in host frames
+        uint32_t num_events;
+        uint32_t num_hops;
+    };
+
+    struct BeatEventRecord {
+        int64_t frame;              // stream position in host frames
+        float activation;
+        uint32_t downbeat;
+    };
+
+    inline constexpr uint32_t ringBytes(uint32_t ring_frames, uint32_t num_channels)
+    {
+        return static_cast<uint32_t>(sizeof(SharedRing) + sizeof(float) * ring_frames * num_channels);
+    }
+}
+
+#endif
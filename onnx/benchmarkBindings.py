@@ -0,0 +1,90 @@
+"""Compares the speed of the Python BeatNet activation extractors with the C++ pipeline (beatnet_cpp).
+
+Build the module with -D BUILD_PYTHON_BINDINGS=ON and put it on the path, then
+
+    python benchmarkBindings.py ../test/test_data/808kick120bpm.mp3
+
+stream:   hop by hop (441 samples at 22050 Hz). Python re-analyses its window for every hop, as
+          activation_extractor_stream does with the microphone input; C++ gets one hop per process().
+realtime: Python activation_extractor_realtime over the file; C++ in 1024 frame blocks at 44.1 kHz.
+online:   Python activation_extractor_online over the whole file; C++ analyze().
+The times only cover activation extraction, not the particle filter or DBN decoding.
+"""
+import os
+import sys
+import time
+
+import librosa
+import numpy as np
+import torch
+
+sys.path.insert(0, os.path.abspath("../src"))
+from BeatNet.BeatNet import BeatNet
+import beatnet_cpp
+
+
+def python_stream(estimator, audio):
+    hop, win = estimator.log_spec_hop_length, estimator.log_spec_win_length
+    window = np.zeros(win + 2 * hop, dtype=np.float32)
+    with torch.no_grad():
+        for start in range(0, len(audio) - hop + 1, hop):
+            window = np.append(window[hop:], audio[start:start + hop])
+            feats = torch.from_numpy(estimator.proc.process_audio(window).T[-1]).unsqueeze(0).unsqueeze(0)
+            estimator.model.final_pred(estimator.model(feats)[0])
+
+
+def python_realtime(estimator, audio):
+    estimator.counter = 0
+    estimator.completed = 0
+    while not estimator.completed:
+        estimator.activation_extractor_realtime(audio)
+        estimator.counter += 1
+
+
+def cpp_blocks(tracker, audio, block_size):
+    hops = 0
+    for start in range(0, len(audio), block_size):
+        activations, _ = tracker.process(audio[start:start + block_size])
+        hops += len(activations)
+    return hops
+
+
+def cpp_tracker(sample_rate, block_size):
+    tracker = beatnet_cpp.BeatNet()
+    tracker.setup(sample_rate, block_size)
+    return tracker
+
+
+def timed(function, *args):
+    start = time.perf_counter()
+    function(*args)
+    return time.perf_counter() - start
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__)
+        sys.exit(1)
+    audio_22k, _ = librosa.load(sys.argv[1], sr=22050)
+    audio_44k, _ = librosa.load(sys.argv[1], sr=44100)
+    audio_22k = np.ascontiguousarray(audio_22k, dtype=np.float32)
+    audio_44k = np.ascontiguousarray(audio_44k, dtype=np.float32)
+    duration = len(audio_22k) / 22050
+
+    # every estimator and tracker (model load, ORT session) is created before its timed region
+    results = {
+        "stream": (timed(python_stream, BeatNet(1, mode='realtime', inference_model='PF'), audio_22k),
+                   timed(cpp_blocks, cpp_tracker(22050, 441), audio_22k, 441)),
+        "realtime": (timed(python_realtime, BeatNet(1, mode='realtime', inference_model='PF'), audio_22k),
+                     timed(cpp_blocks, cpp_tracker(44100, 1024), audio_44k, 1024)),
+        "online": (timed(BeatNet(1, mode='online', inference_model='PF').activation_extractor_online, audio_22k),
+                   timed(beatnet_cpp.BeatNet().analyze, audio_44k, 44100)),
+    }
+    print(f"{duration:.1f} s of audio")
+    for mode, (python_seconds, cpp_seconds) in results.items():
+        print(f"{mode:9s} python {python_seconds:7.3f} s ({duration / python_seconds:7.1f}x real time)   "
+              f"c++ {cpp_seconds:7.3f} s ({duration / cpp_seconds:7.1f}x real time)   speed-up {python_seconds / cpp_seconds:6.1f}x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#include "builtinfft.h"
+#include <cmath>
+#include <cstddef>
+
+bool BuiltinFFT::supportsSize(int size)
+{
+    return size >= 4 && (size & (size - 1)) == 0;
+}
+
+BuiltinFFT::BuiltinFFT(int size):
+    fft_size(size),
+    half_size(size / 2),
+    fft_input(size, 0.0f),
+    work_re(size / 2), work_im(size / 2),
+    tables(DSPTables::fftTwiddles(size))
+{
+}
+
+FFTBackendType BuiltinFFT::type() const
+{
+    return FFTBackendType::Builtin;
+}
+
+int BuiltinFFT::size() const
+{
+    return fft_size;
+}
+
+float* BuiltinFFT::input()
+{
+    return fft_input.data();
+}
+
+void BuiltinFFT::magnitudes(float* output, int num_bins)
+{
+    transform(fft_input.data(), output, num_bins);
+}
+
+void BuiltinFFT::magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                                 float* output, int output_stride, int num_bins)
+{
+    for (int frame = 0; frame < num_frames; ++frame)
+        transform(frames + static_cast<size_t>(frame) * input_stride, output + static_cast<size_t>(frame) * output_stride, num_bins);
+}
+
+void BuiltinFFT::transform(const float* frame, float* output, int num_bins)
+{
+    const int* bit_reverse = tables->bit_reverse.data();
+    const float* twiddle_re = tables->twiddle_re.data();
+    const float* twiddle_im = tables->twiddle_im.data();
+    const float* split_re = tables->split_re.data();
+    const float* split_im = tables->split_im.data();
+
+    // pack even samples into the real part and odd samples into the imaginary part, in bit reversed order
+    for (int m = 0; m < half_size; ++m) {
+        work_re[bit_reverse[m]] = frame[2 * m];
+        work_im[bit_reverse[m]] = frame[2 * m + 1];
+    }
+
+    // iterative radix-2 decimation in time
+    for (int len = 2; len <= half_size; len <<= 1) {
+        int half_len = len / 2;
+        int step = half_size / len;
+        for (int start = 0; start < half_size; start += len) {
+            for (int j = 0; j < half_len; ++j) {
+                float wr = twiddle_re[j * step];
+                float wi = twiddle_im[j * step];
+                int a = start + j;
+                int b = a + half_len;
+                float vr = work_re[b] * wr - work_im[b] * wi;
+                float vi = work_re[b] * wi + work_im[b] * wr;
+                work_re[b] = work_re[a] - vr;
+                work_im[b] = work_im[a] - vi;
+                work_re[a] += vr;
+                work_im[a] += vi;
+            }
+        }
+    }
+
+    // separate the spectra of the even and odd samples and combine them into the real transform
+    for (int k = 0; k < num_bins; ++k) {
+        int i = k % half_size;
+        int c = (half_size - k) % half_size;
+        float zr = work_re[i], zi = work_im[i];
+        float cr = work_re[c], ci = -work_im[c];
+        float even_re = 0.5f * (zr + cr);
+        float even_im = 0.5f * (zi + ci);
+        float odd_re = 0.5f * (zi - ci);
+        float odd_im = -0.5f * (zr - cr);
+        float real = even_re + split_re[k] * odd_re - split_im[k] * odd_im;
+        float imag = even_im + split_re[k] * odd_im + split_im[k] * odd_re;
+        output[k] = std::sqrt(real * real + imag * imag);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef BUILTIN_FFT_H
+#define BUILTIN_FFT_H
+
+#include <memory>
+#include <vector>
+#include "dsptables.h"
+#include "fftbackend.h"
+
+// In-tree radix-2 real FFT for power-of-two sizes, needs no external library.
+// The real input is packed into a half-size complex transform and separated afterwards.
+class BuiltinFFT : public FFTBackend {
+public:
+    explicit BuiltinFFT(int size);
+
+    static bool supportsSize(int size);
+
+    FFTBackendType type() const override;
+    int size() const override;
+    float* input() override;
+    void magnitudes(float* output, int num_bins) override;
+    void magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                         float* output, int output_stride, int num_bins) override;
+
+private:
+    void transform(const float* frame, float* output, int num_bins);
+
+    int fft_size;
+    int half_size;
+    std::vector<float> fft_input;
+    std::vector<float> work_re, work_im;        // half-size complex transform, split format
+    std::shared_ptr<const FFTTwiddleTable> tables;  // shared by every transform of this size
+};
+
+#endif
@@ -0,0 +1,12 @@
+include(FetchContent)
+
+set(PYBIND11_VERSION 2.13.6)
+set(PYBIND11_DIR ${LIBRARY_DIR}/pybind11)
+
+FetchContent_Declare(
+    pybind11
+    URL https://github.com/pybind/pybind11/archive/refs/tags/v${PYBIND11_VERSION}.zip
+    SOURCE_DIR ${PYBIND11_DIR}
+)
+
+FetchContent_MakeAvailable(pybind11)
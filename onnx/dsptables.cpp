@@ -0,0 +1,169 @@
+#include "dsptables.h"
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+namespace {
+    constexpr double TWO_PI = 6.28318530717958647692;
+
+    std::mutex registry_mutex;
+    std::atomic<bool> sharing_enabled { true };
+    std::atomic<size_t> live_tables { 0 };
+    std::atomic<size_t> live_bytes { 0 };
+
+    size_t tableBytes(const AlignedTable<float>& table) { return table.bytes(); }
+    size_t tableBytes(const FilterBankTable& table) { return table.weights.bytes(); }
+    size_t tableBytes(const FFTTwiddleTable& table)
+    {
+        return table.twiddle_re.bytes() + table.twiddle_im.bytes() + table.split_re.bytes() + table.split_im.bytes()
+               + table.bit_reverse.bytes();
+    }
+
+    // hands a freshly built table out, counted until its last holder releases it
+    template<typename Table>
+    std::shared_ptr<const Table> track(std::unique_ptr<Table> table)
+    {
+        const size_t bytes = tableBytes(*table);
+        live_tables++;
+        live_bytes += bytes;
+        return std::shared_ptr<const Table>(table.release(), [bytes](const Table* released) {
+            live_tables--;
+            live_bytes -= bytes;
+            delete released;
+        });
+    }
+
+    // Returns the live table for key or builds one. Building happens under the lock, so concurrent
+    // constructors asking for the same table wait for the first one instead of building it twice.
+    template<typename Table, typename Key, typename Builder>
+    std::shared_ptr<const Table> lookup(std::map<Key, std::weak_ptr<const Table>>& tables, const Key& key, Builder build)
+    {
+        if (!sharing_enabled)
+            return track(build());
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto found = tables.find(key);
+        if (found != tables.end()) {
+            if (std::shared_ptr<const Table> table = found->second.lock())
+                return table;
+        }
+        // drop entries whose tables are gone, the map stays as small as the set of configurations in use
+        for (auto it = tables.begin(); it != tables.end();)
+            it = it->second.expired() ? tables.erase(it) : std::next(it);
+
+        std::shared_ptr<const Table> table = track(build());
+        tables[key] = table;
+        return table;
+    }
+
+    std::unique_ptr<AlignedTable<float>> buildHannWindow(int length)
+    {
+        auto window = std::make_unique<AlignedTable<float>>(static_cast<size_t>(length));
+        for (int i = 0; i < length; ++i)
+            (*window)[i] = static_cast<float>(0.5 * (1.0 - std::cos(TWO_PI * i / (length - 1))));
+        return window;
+    }
+
+    std::unique_ptr<FilterBankTable> buildFilterBank(int bands_per_octave, int fft_size, int sample_rate,
+                                                     float fmin, float fmax, bool norm_filters)
+    {
+        auto hzToBin = [&](float f) { return (f / static_cast<float>(sample_rate)) * fft_size; };
+
+        float num_octaves = std::log2(fmax / fmin);
+        int num_filters = static_cast<int>(std::floor(num_octaves * bands_per_octave));
+        std::vector<float> centers(num_filters + 2);
+        for (size_t i = 0; i < centers.size(); ++i)
+            centers[i] = fmin * std::pow(2.0, (float)i / (float)bands_per_octave);
+
+        const int num_bins = fft_size / 2 + 1;
+        auto table = std::make_unique<FilterBankTable>(num_filters, num_bins);
+        for (int band = 0; band < num_filters; ++band) {
+            float* filt = table->weights.data() + static_cast<size_t>(band) * num_bins;
+            float l = hzToBin(centers[band]);
+            float c = hzToBin(centers[band + 1]);
+            float r = hzToBin(centers[band + 2]);
+
+            for (int j = (int)std::ceil(l); j < (int)std::ceil(c) && j < num_bins; ++j)
+                filt[j] = (j - l) / (c - l);
+
+            for (int j = (int)std::ceil(c); j < (int)std::ceil(r) && j < num_bins; ++j)
+                filt[j] = (r - j) / (r - c);
+
+            if (norm_filters) {
+                float sum = std::accumulate(filt, filt + num_bins, 0.0);
+                if (sum > 0)
+                    for (int j = 0; j < num_bins; ++j) filt[j] /= sum;
+            }
+        }
+        return table;
+    }
+
+    std::unique_ptr<FFTTwiddleTable> buildTwiddles(int size)
+    {
+        const int half_size = size / 2;
+        auto table = std::make_unique<FFTTwiddleTable>(size);
+        for (int k = 0; k < half_size / 2; ++k) {
+            table->twiddle_re[k] = static_cast<float>(std::cos(TWO_PI * k / half_size));
+            table->twiddle_im[k] = static_cast<float>(-std::sin(TWO_PI * k / half_size));
+        }
+        for (int k = 0; k <= half_size; ++k) {
+            table->split_re[k] = static_cast<float>(std::cos(TWO_PI * k / size));
+            table->split_im[k] = static_cast<float>(-std::sin(TWO_PI * k / size));
+        }
+
+        int bits = 0;
+        while ((1 << bits) < half_size) ++bits;
+        for (int i = 0; i < half_size; ++i) {
+            int reversed = 0;
+            for (int b = 0; b < bits; ++b)
+                if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+            table->bit_reverse[i] = reversed;
+        }
+        return table;
+    }
+}
+
+std::shared_ptr<const AlignedTable<float>> DSPTables::hannWindow(int length)
+{
+    static std::map<int, std::weak_ptr<const AlignedTable<float>>> windows;
+    return lookup(windows, length, [&] { return buildHannWindow(length); });
+}
+
+std::shared_ptr<const FilterBankTable> DSPTables::filterBank(int bands_per_octave, int fft_size, int sample_rate,
+                                                             float fmin, float fmax, bool norm_filters)
+{
+    using Key = std::tuple<int, int, int, float, float, bool>;
+    static std::map<Key, std::weak_ptr<const FilterBankTable>> filterbanks;
+    return lookup(filterbanks, Key(bands_per_octave, fft_size, sample_rate, fmin, fmax, norm_filters),
+                  [&] { return buildFilterBank(bands_per_octave, fft_size, sample_rate, fmin, fmax, norm_filters); });
+}
+
+std::shared_ptr<const FFTTwiddleTable> DSPTables::fftTwiddles(int size)
+{
+    static std::map<int, std::weak_ptr<const FFTTwiddleTable>> twiddles;
+    return lookup(twiddles, size, [&] { return buildTwiddles(size); });
+}
+
+void DSPTables::setSharingEnabled(bool enabled)
+{
+    sharing_enabled = enabled;
+}
+
+bool DSPTables::isSharingEnabled()
+{
+    return sharing_enabled;
+}
+
+size_t DSPTables::liveTables()
+{
+    return live_tables;
+}
+
+size_t DSPTables::liveBytes()
+{
+    return live_bytes;
+}
@@ -0,0 +1,82 @@
+#ifndef DSP_TABLES_H
+#define DSP_TABLES_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// Fixed size array whose storage starts on a cache line, for tables that are read on every frame.
+template<typename T>
+class AlignedTable {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    explicit AlignedTable(size_t size):
+        count(size),
+        storage(static_cast<T*>(::operator new(sizeof(T) * (size > 0 ? size : 1), std::align_val_t(ALIGNMENT))))
+    {
+        for (size_t i = 0; i < count; ++i)
+            storage.get()[i] = T();
+    }
+
+    size_t size() const { return count; }
+    size_t bytes() const { return count * sizeof(T); }
+    T* data() { return storage.get(); }
+    const T* data() const { return storage.get(); }
+    T& operator[](size_t i) { return storage.get()[i]; }
+    const T& operator[](size_t i) const { return storage.get()[i]; }
+
+private:
+    struct Release {
+        void operator()(T* p) const { ::operator delete(p, std::align_val_t(ALIGNMENT)); }
+    };
+
+    size_t count;
+    std::unique_ptr<T, Release> storage;
+};
+
+// Triangular filters of FilterBankProcessor, one row of num_bins weights per band
+struct FilterBankTable {
+    FilterBankTable(int bands, int bins): num_bands(bands), num_bins(bins), weights(static_cast<size_t>(bands) * bins) {}
+
+    int num_bands;
+    int num_bins;
+    AlignedTable<float> weights;
+};
+
+// Twiddle factors and bit reversal permutation of BuiltinFFT for one transform size
+struct FFTTwiddleTable {
+    explicit FFTTwiddleTable(int size):
+        twiddle_re(size / 4), twiddle_im(size / 4),
+        split_re(size / 2 + 1), split_im(size / 2 + 1),
+        bit_reverse(size / 2) {}
+
+    AlignedTable<float> twiddle_re, twiddle_im;     // e^(-2 pi i k / (size / 2))
+    AlignedTable<float> split_re, split_im;         // e^(-2 pi i k / size)
+    AlignedTable<int> bit_reverse;
+};
+
+// Process-wide registry of the immutable tables of the feature extraction. Every instance asking for the
+// same configuration gets the same copy, so a host running many trackers (or the daemon running many
+// sessions) keeps one window, filterbank and twiddle table per size instead of one per instance.
+// Tables are built on first use and freed when the last instance holding them goes away; the registry
+// only keeps weak references. Thread safe; lookups lock, so call them while constructing, not per frame.
+class DSPTables {
+public:
+    // symmetric Hann window of FFTProcessor
+    static std::shared_ptr<const AlignedTable<float>> hannWindow(int length);
+    static std::shared_ptr<const FilterBankTable> filterBank(int bands_per_octave, int fft_size, int sample_rate,
+                                                             float fmin, float fmax, bool norm_filters);
+    static std::shared_ptr<const FFTTwiddleTable> fftTwiddles(int size);
+
+    // When disabled, every request builds a private table, as before the registry existed. Only meant
+    // for measuring what sharing saves; enabled by default.
+    static void setSharingEnabled(bool enabled);
+    static bool isSharingEnabled();
+
+    // tables currently held by at least one instance and their size
+    static size_t liveTables();
+    static size_t liveBytes();
+};
+
+#endif
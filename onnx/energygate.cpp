@@ -0,0 +1,64 @@
+#include "energygate.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr float ENERGY_FLOOR_DB = -200.0f;
+}
+
+EnergyGate::EnergyGate(float threshold_db, float flux_db):
+    enabled(false),
+    threshold_db(threshold_db),
+    flux_db(flux_db)
+{
+    reset();
+}
+
+void EnergyGate::configure(bool enabled, float threshold_db, float flux_db)
+{
+    this->enabled = enabled;
+    this->threshold_db = threshold_db;
+    this->flux_db = flux_db;
+}
+
+bool EnergyGate::isEnabled() const
+{
+    return enabled;
+}
+
+void EnergyGate::reset()
+{
+    prev_energy_db = ENERGY_FLOOR_DB;
+    gated_frames.store(0, std::memory_order_relaxed);
+    total_frames.store(0, std::memory_order_relaxed);
+}
+
+bool EnergyGate::process(const float* frame, int length)
+{
+    total_frames.fetch_add(1, std::memory_order_relaxed);
+    if (!enabled)
+        return false;
+
+    float energy = 0.0f;
+    for (int i = 0; i < length; ++i)
+        energy += frame[i] * frame[i];
+    energy /= length;
+
+    float energy_db = energy > 0.0f ? std::max(10.0f * std::log10(energy), ENERGY_FLOOR_DB) : ENERGY_FLOOR_DB;
+    bool gated = energy_db < threshold_db && energy_db - prev_energy_db < flux_db;
+    prev_energy_db = energy_db;
+
+    if (gated)
+        gated_frames.fetch_add(1, std::memory_order_relaxed);
+    return gated;
+}
+
+long long EnergyGate::gatedFrames() const
+{
+    return gated_frames.load(std::memory_order_relaxed);
+}
+
+long long EnergyGate::totalFrames() const
+{
+    return total_frames.load(std::memory_order_relaxed);
+}
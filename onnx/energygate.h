@@ -0,0 +1,37 @@
+#ifndef ENERGY_GATE_H
+#define ENERGY_GATE_H
+
+#include <atomic>
+
+// Cheap per-hop test in front of the FFT: frames that are quiet and do not rise in level are not worth
+// a transform and a model run. Works on the time domain frame, using the frame energy and its increase
+// over the previous hop (a time domain stand-in for the positive spectral flux the model looks at).
+class EnergyGate {
+public:
+    // disabled by default
+    EnergyGate(float threshold_db = -60.0f, float flux_db = 6.0f);
+
+    // A frame is gated when its energy is below threshold_db (dBFS, mean square) and it is less than
+    // flux_db louder than the previous one.
+    void configure(bool enabled, float threshold_db, float flux_db);
+    bool isEnabled() const;
+
+    // true if the frame can skip DSP and inference
+    bool process(const float* frame, int length);
+    void reset();
+
+    // may be read from any thread
+    long long gatedFrames() const;
+    long long totalFrames() const;
+
+private:
+    bool enabled;
+    float threshold_db;
+    float flux_db;
+    float prev_energy_db;
+
+    std::atomic<long long> gated_frames;
+    std::atomic<long long> total_frames;
+};
+
+#endif
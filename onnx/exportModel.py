@@ -2,20 +2,35 @@ import sys
 import os
 import torch
 import torch.nn as nn
+import torch.nn.functional as F
 import onnx
 sys.path.insert(0, os.path.abspath("../src"))
 from BeatNet.BeatNet import BeatNet
 
 class BeatNetWithSoftmax(nn.Module):
+    """BDA + softmax with the LSTM state as explicit inputs and outputs.
+
+    BDA keeps its state in self.hidden/self.cell, which the exporter would freeze as constants, so every
+    Run in ONNX Runtime would start from zeros. Passing the state through lets the C++ side carry it
+    across Run calls and feed several hops at once along the time axis.
+    """
     def __init__(self, base_model):
         super().__init__()
         self.base_model = base_model
         self.softmax = nn.Softmax(dim=1)
 
-    def forward(self, x):
-        logits = self.base_model(x)
-        return self.softmax(logits)
-    
+    def forward(self, x, h0, c0):
+        bda = self.base_model
+        batch, time = x.shape[0], x.shape[1]
+        y = torch.reshape(x, (-1, bda.dim_in)).unsqueeze(1)
+        y = F.max_pool1d(F.relu(bda.conv1(y)), 2)
+        y = y.view(-1, bda.num_flat_features(y))
+        y = bda.linear0(y)
+        y = torch.reshape(y, (batch, time, bda.conv_out))
+        y, (hn, cn) = bda.lstm(y, (h0, c0))
+        logits = bda.linear(y).transpose(1, 2)
+        return self.softmax(logits), hn, cn
+
 model_path = "beatnet_bda.onnx"
 
 # Initialize BeatNet
@@ -34,15 +49,17 @@ model.to(device)
 # Create dummy input (batch_size, time_steps, feature_dim)
 print("Expected dim_in:", model.base_model.dim_in)
 dummy_input = torch.randn(1, 1, 272).to(device)
+dummy_state = torch.zeros(model.base_model.num_layers, 1, model.base_model.dim_hd).to(device)
 
 # export to ONNX
 torch.onnx.export(
     model,
-    dummy_input,
+    (dummy_input, dummy_state, dummy_state),
     model_path,
-    input_names=["input"],
-    output_names=["output"],
-    dynamic_axes={"input": {0: "batch", 1: "time"}, "output": {0: "batch", 2: "time"}},
+    input_names=["input", "h0", "c0"],
+    output_names=["output", "hn", "cn"],
+    dynamic_axes={"input": {0: "batch", 1: "time"}, "output": {0: "batch", 2: "time"},
+                  "h0": {1: "batch"}, "c0": {1: "batch"}, "hn": {1: "batch"}, "cn": {1: "batch"}},
     opset_version=17
 )
 
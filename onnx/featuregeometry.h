@@ -0,0 +1,121 @@
+#ifndef FEATURE_GEOMETRY_H
+#define FEATURE_GEOMETRY_H
+
+constexpr int SR_BEATNET {22050};
+constexpr double MS_FR_PAPER {0.093};
+constexpr double MS_HOP_PAPER {0.046};
+constexpr double MS_FR_GITHUB {0.064};
+constexpr double MS_HOP_GITHUB {0.020};
+constexpr int FRAME_LENGTH {static_cast<int>(SR_BEATNET*MS_FR_GITHUB)}; // 1411
+constexpr int HOP_SIZE {static_cast<int>(SR_BEATNET*MS_HOP_GITHUB)}; // 441
+constexpr int FFT_SIZE { FRAME_LENGTH / 2 + 1}; // 706
+constexpr int FRAME_SIZE_POW2 {2048}; // this is the minumum higher than FRAME_LENGTH (1411) that is a power-of-two value.
+constexpr int FBANK_SIZE {272};
+constexpr int BANKS_PER_OCTAVE {16}; // {24};;
+constexpr int FBANK_FMIN {30};
+constexpr int FBANK_FMAX {11025};
+
+constexpr int FRAME_LENGTH_PAPER {static_cast<int>(SR_BEATNET*MS_FR_PAPER)}; // 2050
+constexpr int HOP_SIZE_PAPER {static_cast<int>(SR_BEATNET*MS_HOP_PAPER)}; // 1014
+constexpr int FRAME_SIZE_POW2_PAPER {4096};
+
+// Math helpers usable in constant expressions, used to build the DSP tables at compile time.
+namespace ConstexprMath {
+
+    constexpr double PI = 3.14159265358979323846;
+    constexpr double LN2 = 0.69314718055994530942;
+
+    constexpr double floor(double x) {
+        double t = static_cast<double>(static_cast<long long>(x));
+        return t > x ? t - 1.0 : t;
+    }
+
+    constexpr double ceil(double x) {
+        double t = static_cast<double>(static_cast<long long>(x));
+        return t < x ? t + 1.0 : t;
+    }
+
+    constexpr double cos(double x) {
+        // reduce to [-pi, pi], then Taylor series
+        x -= 2.0 * PI * floor((x + PI) / (2.0 * PI));
+        double term = 1.0;
+        double sum = 1.0;
+        for (int n = 1; n < 20; ++n) {
+            term *= -x * x / ((2.0 * n - 1.0) * (2.0 * n));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr double exp2(double x) {
+        // 2^x = 2^int(x) * e^(frac(x) ln2)
+        double whole = floor(x);
+        double scale = 1.0;
+        for (int i = 0; i < static_cast<int>(whole); ++i) scale *= 2.0;
+        for (int i = 0; i > static_cast<int>(whole); --i) scale *= 0.5;
+        double y = (x - whole) * LN2;
+        double term = 1.0;
+        double sum = 1.0;
+        for (int n = 1; n < 20; ++n) {
+            term *= y / n;
+            sum += term;
+        }
+        return scale * sum;
+    }
+}
+
+// Frame, hop and filterbank layout of the feature extraction, known at compile time.
+template<int SampleRate, int FrameLength, int HopSize, int FramePow2, int BandsPerOctave, int FMin, int FMax>
+struct FeatureGeometry {
+    static constexpr int sample_rate = SampleRate;
+    static constexpr int frame_length = FrameLength;
+    static constexpr int hop_size = HopSize;
+    static constexpr int frame_size_pow2 = FramePow2;
+    static constexpr int fft_size = FrameLength / 2 + 1;
+    static constexpr int bands_per_octave = BandsPerOctave;
+    static constexpr int fmin = FMin;
+    static constexpr int fmax = FMax;
+
+    // floor(log2(fmax / fmin) * bands_per_octave)
+    static constexpr int countBands() {
+        int n = 0;
+        while (FMin * ConstexprMath::exp2(static_cast<double>(n + 1) / BandsPerOctave) <= FMax) ++n;
+        return n;
+    }
+    static constexpr int num_bands = countBands();
+    static constexpr int feature_size = 2 * num_bands;
+
+    // the filterbank spans the spectrum as if it had fft_size bins over [0, sample_rate]
+    static constexpr int filter_length = fft_size / 2 + 1;
+    static constexpr double centre(int i) {
+        return FMin * ConstexprMath::exp2(static_cast<double>(i) / BandsPerOctave);
+    }
+    static constexpr double hzToBin(double f) {
+        return static_cast<float>(f) / static_cast<float>(SampleRate) * fft_size;
+    }
+    static constexpr int filterStart(int band) {
+        return static_cast<int>(ConstexprMath::ceil(hzToBin(centre(band))));
+    }
+    static constexpr int filterEnd(int band) {
+        int end = static_cast<int>(ConstexprMath::ceil(hzToBin(centre(band + 2))));
+        return end < filter_length ? end : filter_length;
+    }
+    static constexpr int maxFilterWidth() {
+        int width = 1;
+        for (int band = 0; band < num_bands; ++band)
+            if (filterEnd(band) - filterStart(band) > width)
+                width = filterEnd(band) - filterStart(band);
+        return width;
+    }
+    static constexpr int filter_width = maxFilterWidth();
+
+    static_assert(FrameLength <= FramePow2, "the padded FFT size must hold a whole frame");
+    static_assert(HopSize <= FrameLength, "frames must overlap or touch");
+};
+
+using GithubGeometry = FeatureGeometry<SR_BEATNET, FRAME_LENGTH, HOP_SIZE, FRAME_SIZE_POW2, BANKS_PER_OCTAVE, FBANK_FMIN, FBANK_FMAX>;
+using PaperGeometry = FeatureGeometry<SR_BEATNET, FRAME_LENGTH_PAPER, HOP_SIZE_PAPER, FRAME_SIZE_POW2_PAPER, BANKS_PER_OCTAVE, FBANK_FMIN, FBANK_FMAX>;
+
+static_assert(GithubGeometry::feature_size == FBANK_SIZE, "the model expects 272 features per frame");
+
+#endif
@@ -0,0 +1,170 @@
+#include "fftbackend.h"
+#include "builtinfft.h"
+#ifdef ENABLE_FFTW3
+#include "fftw3backend.h"
+#endif
+#ifdef ENABLE_KISSFFT
+#include "kissfftbackend.h"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <utility>
+
+const char* FFTBackend::name(FFTBackendType type)
+{
+    switch (type) {
+        case FFTBackendType::Auto: return "auto";
+        case FFTBackendType::FFTW3: return "fftw3";
+        case FFTBackendType::KissFFT: return "kissfft";
+        case FFTBackendType::Builtin: return "builtin";
+    }
+    return "unknown";
+}
+
+bool FFTBackend::supportsSize(FFTBackendType type, int size)
+{
+    switch (type) {
+        case FFTBackendType::FFTW3:
+        case FFTBackendType::KissFFT:
+            return size > 1;
+        case FFTBackendType::Builtin:
+            return BuiltinFFT::supportsSize(size);
+        default:
+            return false;
+    }
+}
+
+void FFTBackend::magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                                 float* output, int output_stride, int num_bins)
+{
+    float* frame_input = input();
+    for (int frame = 0; frame < num_frames; ++frame) {
+        const float* source = frames + static_cast<size_t>(frame) * input_stride;
+        std::copy(source, source + size(), frame_input);
+        magnitudes(output + static_cast<size_t>(frame) * output_stride, num_bins);
+    }
+}
+
+std::unique_ptr<FFTBackend> FFTBackend::create(FFTBackendType type, int size)
+{
+    if (!supportsSize(type, size))
+        return nullptr;
+
+    std::unique_ptr<FFTBackend> backend;
+    switch (type) {
+#ifdef ENABLE_FFTW3
+        case FFTBackendType::FFTW3: {
+            auto fftw = std::make_unique<FFTW3Backend>(size);
+            if (fftw->isValid())
+                backend = std::move(fftw);
+            break;
+        }
+#endif
+#ifdef ENABLE_KISSFFT
+        case FFTBackendType::KissFFT:
+            backend = std::make_unique<KissFFTBackend>(size);
+            break;
+#endif
+        case FFTBackendType::Builtin:
+            backend = std::make_unique<BuiltinFFT>(size);
+            break;
+        default:
+            break;
+    }
+    return backend;
+}
+
+std::vector<FFTBackendType> FFTBackend::available(int size)
+{
+    std::vector<FFTBackendType> types;
+    for (FFTBackendType type : { FFTBackendType::FFTW3, FFTBackendType::Builtin, FFTBackendType::KissFFT }) {
+        bool loadable = false;
+        switch (type) {
+#ifdef ENABLE_FFTW3
+            case FFTBackendType::FFTW3: loadable = FFTW3Backend::isLibraryAvailable(); break;
+#endif
+#ifdef ENABLE_KISSFFT
+            case FFTBackendType::KissFFT: loadable = true; break;
+#endif
+            case FFTBackendType::Builtin: loadable = true; break;
+            default: break;
+        }
+        if (loadable && supportsSize(type, size))
+            types.push_back(type);
+    }
+    return types;
+}
+
+namespace {
+    std::atomic<bool> autotune_enabled { false };
+    std::mutex timings_mutex;
+    std::map<std::pair<int, int>, double> timings; // (backend, size) -> ns per transform
+}
+
+void FFTAutoTuner::setEnabled(bool enabled)
+{
+    autotune_enabled = enabled;
+}
+
+bool FFTAutoTuner::isEnabled()
+{
+    return autotune_enabled;
+}
+
+double FFTAutoTuner::measure(FFTBackendType type, int size)
+{
+    std::lock_guard<std::mutex> lock(timings_mutex);
+    auto key = std::make_pair(static_cast<int>(type), size);
+    auto found = timings.find(key);
+    if (found != timings.end())
+        return found->second;
+
+    double ns_per_frame = 0.0;
+    std::unique_ptr<FFTBackend> backend = FFTBackend::create(type, size);
+    if (backend) {
+        std::vector<float> output(size / 2 + 1);
+        float* input = backend->input();
+        for (int i = 0; i < size; ++i)
+            input[i] = static_cast<float>((i * 7919) % 113) / 113.0f - 0.5f;
+
+        // warm up caches (and FFTW's lazy initialisation) before timing
+        for (int i = 0; i < 16; ++i)
+            backend->magnitudes(output.data(), size / 2 + 1);
+
+        // best of a few rounds, to be robust against preemption
+        const int rounds = 5;
+        const int iterations = 64;
+        for (int round = 0; round < rounds; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i)
+                backend->magnitudes(output.data(), size / 2 + 1);
+            auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+            ns_per_frame = round == 0 ? elapsed : std::min(ns_per_frame, elapsed);
+        }
+    }
+    timings[key] = ns_per_frame;
+    return ns_per_frame;
+}
+
+FFTBackendType FFTAutoTuner::choose(int size)
+{
+    std::vector<FFTBackendType> candidates = FFTBackend::available(size);
+    if (candidates.empty())
+        return FFTBackendType::Builtin;
+    if (!isEnabled())
+        return candidates.front();
+
+    FFTBackendType fastest = candidates.front();
+    double fastest_ns = measure(fastest, size);
+    for (FFTBackendType type : candidates) {
+        double ns = measure(type, size);
+        if (ns > 0.0 && ns < fastest_ns) {
+            fastest = type;
+            fastest_ns = ns;
+        }
+    }
+    return fastest;
+}
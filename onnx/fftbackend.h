@@ -0,0 +1,50 @@
+#ifndef FFT_BACKEND_H
+#define FFT_BACKEND_H
+
+#include <memory>
+#include <vector>
+
+enum class FFTBackendType { Auto, FFTW3, KissFFT, Builtin };
+
+// Forward real-to-complex transform of a fixed size.
+// The caller fills input(); implementations must leave it untouched, so zero padding is only written once.
+class FFTBackend {
+public:
+    virtual ~FFTBackend() = default;
+
+    virtual FFTBackendType type() const = 0;
+    virtual int size() const = 0;
+    virtual float* input() = 0;
+
+    // runs the transform and writes the magnitude of the first num_bins bins
+    virtual void magnitudes(float* output, int num_bins) = 0;
+
+    // Transforms num_frames frames stored input_stride floats apart, writing their magnitudes output_stride
+    // floats apart. The default goes through input() frame by frame (overwriting it), backends that can
+    // read the frames in place override it.
+    virtual void magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                                 float* output, int output_stride, int num_bins);
+
+    static const char* name(FFTBackendType type);
+    static bool supportsSize(FFTBackendType type, int size);
+    // Backends compiled into this build whose library loads and that support the size. Nothing is created, so
+    // this is cheap: an FFTW plan would be measured just to be thrown away. The library check runs once.
+    static std::vector<FFTBackendType> available(int size);
+    // nullptr if the backend is not compiled in, does not support the size or fails to load
+    static std::unique_ptr<FFTBackend> create(FFTBackendType type, int size);
+};
+
+// Picks the fastest backend for a transform size by timing all of them.
+// Results are measured once per process and shared by every instance.
+class FFTAutoTuner {
+public:
+    // when disabled, Auto resolves to the first available backend in the order FFTW3, Builtin, KissFFT
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    static FFTBackendType choose(int size);
+    // average time of one transform in nanoseconds, 0 if the backend is not available
+    static double measure(FFTBackendType type, int size);
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifdef ENABLE_FFTW3
+
+#include "fftw3backend.h"
+#include "dynamic_link.h"
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+
+namespace {
+    // the FFTW planner is not thread safe, executing plans is
+    std::mutex planner_mutex;
+}
+
+bool FFTW3Backend::loadLibfftw3()
+{
+    std::string libname;
+    #if defined(_WIN32)
+        libname = PluginUtils::makePlatformLibName("lib", dynamiclibname+"-3", ".dll");
+    #elif defined(__APPLE__)
+        libname = PluginUtils::makePlatformLibName("lib", dynamiclibname, ".dylib");
+    #else
+        libname = PluginUtils::makePlatformLibName("lib", dynamiclibname, ".so");
+    #endif
+
+    fftw_handle = PluginUtils::loadDynamicLibrary(libname);
+    if (!fftw_handle) {
+        std::cerr << "Failed to load "<< libname << std::endl;
+        return false;
+    }
+
+    // Load symbols
+    fftwf_malloc_func = reinterpret_cast<fftwf_malloc_t>(PluginUtils::getSymbol(fftw_handle, "fftwf_malloc"));
+    fftwf_free_func = reinterpret_cast<fftwf_free_t>(PluginUtils::getSymbol(fftw_handle, "fftwf_free"));
+    fftwf_plan_dft_r2c_1d_func = reinterpret_cast<fftwf_plan_dft_r2c_1d_t>(PluginUtils::getSymbol(fftw_handle, "fftwf_plan_dft_r2c_1d"));
+    fftwf_plan_many_dft_r2c_func = reinterpret_cast<fftwf_plan_many_dft_r2c_t>(PluginUtils::getSymbol(fftw_handle, "fftwf_plan_many_dft_r2c"));
+    fftwf_execute_func = reinterpret_cast<fftwf_execute_t>(PluginUtils::getSymbol(fftw_handle, "fftwf_execute"));
+    fftwf_destroy_plan_func = reinterpret_cast<fftwf_destroy_plan_t>(PluginUtils::getSymbol(fftw_handle, "fftwf_destroy_plan"));
+
+    if (!fftwf_malloc_func || !fftwf_free_func || !fftwf_plan_dft_r2c_1d_func || !fftwf_plan_many_dft_r2c_func || !fftwf_execute_func || !fftwf_destroy_plan_func) {
+        std::cerr << "Failed to load one or more FFTW symbols" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FFTW3Backend::isLibraryAvailable()
+{
+    static const bool available = [] {
+        // size 0 loads the library and its symbols without allocating or planning
+        FFTW3Backend probe(0);
+        return probe.library_loaded;
+    }();
+    return available;
+}
+
+FFTW3Backend::FFTW3Backend(int size):
+    fft_size(size)
+{
+    library_loaded = loadLibfftw3();
+    if (!library_loaded)
+    {
+        std::cerr << "Could not load fftw3 dll"<<std::endl;
+        return;
+    }
+    if (fft_size <= 0) {
+        return;
+    }
+
+    // Allocate FFT buffers
+    fft_input = (float*)fftwf_malloc_func(sizeof(float) * fft_size);
+    fft_output = (fftwf_complex*)fftwf_malloc_func(sizeof(fftwf_complex) * (fft_size / 2 + 1));
+
+    // Create FFT plan, the out-of-place r2c plan preserves its input
+    std::lock_guard<std::mutex> lock(planner_mutex);
+    fft_plan = fftwf_plan_dft_r2c_1d_func(fft_size, fft_input, fft_output, FFTW_MEASURE);
+}
+
+FFTW3Backend::~FFTW3Backend()
+{
+    if (fft_plan) {
+        std::lock_guard<std::mutex> lock(planner_mutex);
+        fftwf_destroy_plan_func(fft_plan);
+    }
+    if (fft_input) fftwf_free_func(fft_input);
+    if (fft_output) fftwf_free_func(fft_output);
+    if (batch_output) fftwf_free_func(batch_output);
+
+    if (fftw_handle)
+    {
+        PluginUtils::unloadDynamicLibrary(fftw_handle);
+    }
+}
+
+bool FFTW3Backend::isValid() const
+{
+    return fft_plan != nullptr;
+}
+
+FFTBackendType FFTW3Backend::type() const
+{
+    return FFTBackendType::FFTW3;
+}
+
+int FFTW3Backend::size() const
+{
+    return fft_size;
+}
+
+float* FFTW3Backend::input()
+{
+    return fft_input;
+}
+
+void FFTW3Backend::magnitudes(float* output, int num_bins)
+{
+    fftwf_execute_func(fft_plan);
+
+    for (int i = 0; i < num_bins; ++i) {
+        float real = fft_output[i][0];
+        float imag = fft_output[i][1];
+        output[i] = std::sqrt(real * real + imag * imag);
+    }
+}
+
+void FFTW3Backend::magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                                   float* output, int output_stride, int num_bins)
+{
+    if (num_frames <= 0)
+        return;
+
+    const int bins = fft_size / 2 + 1;
+    if (num_frames > batch_capacity) {
+        if (batch_output) fftwf_free_func(batch_output);
+        batch_output = (fftwf_complex*)fftwf_malloc_func(sizeof(fftwf_complex) * bins * static_cast<size_t>(num_frames));
+        batch_capacity = num_frames;
+    }
+
+    // FFTW_ESTIMATE does not touch the arrays while planning, and the out-of-place r2c transform preserves
+    // its input, so the frames can be planned and transformed where they are
+    fftwf_plan plan;
+    {
+        std::lock_guard<std::mutex> lock(planner_mutex);
+        plan = fftwf_plan_many_dft_r2c_func(1, &fft_size, num_frames,
+                                            const_cast<float*>(frames), nullptr, 1, input_stride,
+                                            batch_output, nullptr, 1, bins,
+                                            FFTW_ESTIMATE);
+    }
+    if (!plan) {
+        FFTBackend::magnitudesBatch(frames, num_frames, input_stride, output, output_stride, num_bins);
+        return;
+    }
+
+    fftwf_execute_func(plan);
+
+    for (int frame = 0; frame < num_frames; ++frame) {
+        const fftwf_complex* spectrum = batch_output + static_cast<size_t>(frame) * bins;
+        float* magnitudes = output + static_cast<size_t>(frame) * output_stride;
+        for (int i = 0; i < num_bins; ++i) {
+            float real = spectrum[i][0];
+            float imag = spectrum[i][1];
+            magnitudes[i] = std::sqrt(real * real + imag * imag);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(planner_mutex);
+    fftwf_destroy_plan_func(plan);
+}
+
+#endif
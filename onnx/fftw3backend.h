@@ -0,0 +1,53 @@
+#ifndef FFTW3_BACKEND_H
+#define FFTW3_BACKEND_H
+
+#include <string>
+#include <fftw3.h>
+#include "fftbackend.h"
+
+using fftwf_malloc_t = void* (*)(size_t);
+using fftwf_free_t = void (*)(void*);
+using fftwf_plan_dft_r2c_1d_t = fftwf_plan (*)(int, float*, fftwf_complex*, unsigned);
+using fftwf_plan_many_dft_r2c_t = fftwf_plan (*)(int, const int*, int, float*, const int*, int, int, fftwf_complex*, const int*, int, int, unsigned);
+using fftwf_execute_t = void (*)(const fftwf_plan);
+using fftwf_destroy_plan_t = void (*)(fftwf_plan);
+
+// FFTW3, loaded at run time. Supports any transform size.
+class FFTW3Backend : public FFTBackend {
+public:
+    explicit FFTW3Backend(int size);
+    ~FFTW3Backend() override;
+
+    bool isValid() const;
+    // whether libfftw3f loads and has every symbol the backend uses; checked once per process
+    static bool isLibraryAvailable();
+
+    FFTBackendType type() const override;
+    int size() const override;
+    float* input() override;
+    void magnitudes(float* output, int num_bins) override;
+    // one fftwf_plan_many_dft_r2c over all frames, executed in place on the caller's buffer
+    void magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                         float* output, int output_stride, int num_bins) override;
+
+private:
+    int fft_size;
+    float* fft_input = nullptr;
+    fftwf_complex* fft_output = nullptr;
+    fftwf_plan fft_plan = nullptr;
+    fftwf_complex* batch_output = nullptr;
+    int batch_capacity = 0;
+
+    bool loadLibfftw3();
+    const std::string dynamiclibname = "fftw3f";
+    void* fftw_handle = nullptr;
+    bool library_loaded = false;
+    fftwf_malloc_t fftwf_malloc_func = nullptr;
+    fftwf_free_t fftwf_free_func = nullptr;
+    fftwf_plan_dft_r2c_1d_t fftwf_plan_dft_r2c_1d_func = nullptr;
+    fftwf_plan_many_dft_r2c_t fftwf_plan_many_dft_r2c_func = nullptr;
+    fftwf_execute_t fftwf_execute_func = nullptr;
+    fftwf_destroy_plan_t fftwf_destroy_plan_func = nullptr;
+};
+
+#endif
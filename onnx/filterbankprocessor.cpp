@@ -20,42 +20,16 @@ FilterBankProcessor::FilterBankProcessor(
 }
 
 void FilterBankProcessor::buildFilters() {
-    filters.clear();
-    float num_octaves = std::log2(fmax / fmin);
-    int num_filters = static_cast<int>(std::floor(num_octaves * bands_per_octave));
-    std::vector<float> centers(num_filters + 2);
-
-    for (int i = 0; i < centers.size(); ++i) {
-        centers[i] = fmin * std::pow(2.0, (float)i / (float)bands_per_octave);
-    }
-
-    for (int i = 1; i < centers.size() - 1; ++i) {
-        std::vector<float> filt(fft_size / 2 + 1, 0.0);
-        float l = hzToBin(centers[i - 1]);
-        float c = hzToBin(centers[i]);
-        float r = hzToBin(centers[i + 1]);
-
-        for (int j = (int)std::ceil(l); j < (int)std::ceil(c) && j < filt.size(); ++j)
-            filt[j] = (j - l) / (c - l);
-
-        for (int j = (int)std::ceil(c); j < (int)std::ceil(r) && j < filt.size(); ++j)
-            filt[j] = (r - j) / (r - c);
-
-        if (norm_filters) {
-            float sum = std::accumulate(filt.begin(), filt.end(), 0.0);
-            if (sum > 0)
-                for (auto &v : filt) v /= sum;
-        }
-
-        filters.push_back(std::move(filt));
-    }
+    filters = DSPTables::filterBank(bands_per_octave, fft_size, sample_rate, fmin, fmax, norm_filters);
 }
 
 std::vector<float> FilterBankProcessor::apply(const std::vector<float> &spectrum) const {
-    std::vector<float> out(filters.size(), 0.0);
-    for (size_t i = 0; i < filters.size(); ++i) {
-        for (size_t j = 0; j < spectrum.size() && j < filters[i].size(); ++j) {
-            out[i] += spectrum[j] * filters[i][j];
+    const size_t num_bins = std::min(spectrum.size(), static_cast<size_t>(filters->num_bins));
+    std::vector<float> out(filters->num_bands, 0.0);
+    for (int i = 0; i < filters->num_bands; ++i) {
+        const float* filt = filters->weights.data() + static_cast<size_t>(i) * filters->num_bins;
+        for (size_t j = 0; j < num_bins; ++j) {
+            out[i] += spectrum[j] * filt[j];
         }
     }
     return out;
@@ -63,9 +37,5 @@ std::vector<float> FilterBankProcessor::apply(const std::vector<float> &spectrum
 
 int FilterBankProcessor::numBands() const 
 { 
-    return (int)filters.size();
+    return filters->num_bands;
 }
-
-float FilterBankProcessor::hzToBin(float f) const {
-    return (f / (float)sample_rate) * fft_size;
-}
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <cmath>
 #include <numeric>
 #include <algorithm>
+#include <memory>
+#include "dsptables.h"
 
 class FilterBankProcessor {
 
@@ -13,6 +15,7 @@ public:
                         float fmin = 30.0, float fmax = 17000.0,
                         bool norm_filters = true, bool unique_filters = true);
 
+    // fetches the filters of the current configuration from DSPTables, built once per configuration
     void buildFilters();
 
     std::vector<float> apply(const std::vector<float> &spectrum) const;
@@ -27,9 +30,7 @@ private:
     float fmax;
     bool norm_filters;
     bool unique_filters;
-    std::vector<std::vector<float>> filters;
-
-    float hzToBin(float f) const;
+    std::shared_ptr<const FilterBankTable> filters;
 
 };
 
@@ -0,0 +1,301 @@
+#include "fixedlagdecoder.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // madmom's defaults for the downbeat DBN
+    constexpr int METERS[] = { 2, 3, 4 };
+    constexpr double TRANSITION_LAMBDA = 100.0;
+    constexpr int OBSERVATION_LAMBDA = 16;
+    // tempo changes less likely than this are not followed
+    constexpr double MIN_TRANSITION_PROBABILITY = 1e-6;
+    constexpr float MIN_ACTIVATION = 1e-7f;
+}
+
+FixedLagDecoder::FixedLagDecoder():
+    frame_rate(50.0), lag_frames(0), max_beam(0), beam(0), num_states(0),
+    frames_seen(0), last_beat_frame(0), min_beat_gap(1), beat_window(0), flushing(false), flush_frame(0)
+{
+}
+
+void FixedLagDecoder::configure(int lag, int max_beam_width, double fps, double min_bpm, double max_bpm)
+{
+    frame_rate = fps;
+    lag_frames = std::max(0, lag);
+    max_beam = std::max(1, max_beam_width);
+    beam = max_beam;
+
+    intervals.clear();
+    for (int interval = static_cast<int>(std::lround(60.0 * fps / max_bpm)); interval <= std::lround(60.0 * fps / min_bpm); ++interval)
+        intervals.push_back(std::max(1, interval));
+    const int num_tempi = static_cast<int>(intervals.size());
+
+    // blocks are laid out meter by meter, tempo by tempo, so the block of (meter, tempo) is meter * num_tempi + tempo
+    blocks.clear();
+    num_states = 0;
+    for (int beats : METERS) {
+        for (int tempo = 0; tempo < num_tempi; ++tempo) {
+            blocks.push_back({ beats, intervals[tempo], tempo, num_states });
+            num_states += beats * intervals[tempo];
+        }
+    }
+
+    state_block.assign(num_states, 0);
+    state_observation.assign(num_states, 0);
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const Block& block = blocks[b];
+        for (int position = 0; position < block.beats * block.interval; ++position) {
+            state_block[block.first + position] = static_cast<uint16_t>(b);
+            // the first 1/OBSERVATION_LAMBDA of every beat expects a beat, of the first beat a downbeat
+            if ((position % block.interval) * OBSERVATION_LAMBDA < block.interval)
+                state_observation[block.first + position] = position < block.interval ? 2 : 1;
+        }
+    }
+
+    tempo_transitions.assign(num_tempi, {});
+    for (int from = 0; from < num_tempi; ++from) {
+        std::vector<double> probabilities(num_tempi);
+        double sum = 0.0;
+        for (int to = 0; to < num_tempi; ++to) {
+            probabilities[to] = std::exp(-TRANSITION_LAMBDA * std::abs(static_cast<double>(intervals[to]) / intervals[from] - 1.0));
+            sum += probabilities[to];
+        }
+        for (int to = 0; to < num_tempi; ++to)
+            if (probabilities[to] / sum >= MIN_TRANSITION_PROBABILITY)
+                tempo_transitions[from].push_back({ to, static_cast<float>(std::log(probabilities[to] / sum)) });
+    }
+
+    size_t max_successors = 1;
+    for (const std::vector<TempoTransition>& transitions : tempo_transitions)
+        max_successors = std::max(max_successors, transitions.size());
+    const size_t capacity = std::max(static_cast<size_t>(num_states), static_cast<size_t>(max_beam) * max_successors);
+    slot.assign(num_states, -1);
+    active.reserve(capacity);
+    candidates.reserve(capacity);
+
+    // besides the frame being decided, the longest beat interval before it: the best path may move a beat that
+    // was not emitted yet back by up to a beat's observation region, or further when the tempo changes
+    beat_window = intervals.back();
+    history.assign(lag_frames + beat_window + 1, {});
+    for (Frame& frame : history) {
+        frame.states.reserve(std::min(max_beam, num_states));
+        frame.back.reserve(std::min(max_beam, num_states));
+    }
+    path.reserve(history.size());
+    min_beat_gap = std::max(1, intervals.front() / 2);
+    reset();
+}
+
+void FixedLagDecoder::reset()
+{
+    active.clear();
+    candidates.clear();
+    frames_seen = 0;
+    last_beat_frame = std::numeric_limits<long long>::min() / 2;
+    flushing = false;
+    flush_frame = 0;
+    path.clear();
+}
+
+void FixedLagDecoder::setBeamWidth(int width)
+{
+    beam = std::min(std::max(1, width), max_beam);
+}
+
+int FixedLagDecoder::beamWidth() const
+{
+    return beam;
+}
+
+int FixedLagDecoder::lag() const
+{
+    return lag_frames;
+}
+
+int FixedLagDecoder::numStates() const
+{
+    return num_states;
+}
+
+FixedLagDecoder::Frame& FixedLagDecoder::frameAt(long long frame)
+{
+    return history[static_cast<size_t>(frame % static_cast<long long>(history.size()))];
+}
+
+const FixedLagDecoder::Frame& FixedLagDecoder::frameAt(long long frame) const
+{
+    return history[static_cast<size_t>(frame % static_cast<long long>(history.size()))];
+}
+
+void FixedLagDecoder::expand()
+{
+    candidates.clear();
+    if (active.empty()) {
+        // uniform start over the whole state space
+        for (int32_t state = 0; state < num_states; ++state)
+            candidates.push_back({ 0.0f, state, -1 });
+        return;
+    }
+
+    auto add = [this](int32_t state, float score, int32_t back) {
+        int32_t& index = slot[state];
+        if (index < 0) {
+            index = static_cast<int32_t>(candidates.size());
+            candidates.push_back({ score, state, back });
+        } else if (score > candidates[index].score) {
+            candidates[index].score = score;
+            candidates[index].back = back;
+        }
+    };
+
+    for (int32_t i = 0; i < static_cast<int32_t>(active.size()); ++i) {
+        const Hypothesis& hypothesis = active[i];
+        const int block_index = state_block[hypothesis.state];
+        const Block& block = blocks[block_index];
+        const int position = hypothesis.state - block.first;
+        if ((position + 1) % block.interval != 0) {
+            add(hypothesis.state + 1, hypothesis.score, i);
+            continue;
+        }
+        // a beat ends: the next one starts at any tempo close enough to the current one
+        const int next_beat = ((position + 1) / block.interval) % block.beats;
+        const int meter_first_block = block_index - block.tempo;
+        for (const TempoTransition& transition : tempo_transitions[block.tempo]) {
+            const Block& next = blocks[meter_first_block + transition.to];
+            add(next.first + next_beat * next.interval, hypothesis.score + transition.log_probability, i);
+        }
+    }
+    for (const Hypothesis& candidate : candidates)
+        slot[candidate.state] = -1;
+}
+
+void FixedLagDecoder::prune()
+{
+    if (static_cast<int>(candidates.size()) > beam) {
+        std::nth_element(candidates.begin(), candidates.begin() + beam, candidates.end(),
+                         [](const Hypothesis& a, const Hypothesis& b) { return a.score > b.score; });
+        candidates.resize(beam);
+    }
+    float best = -std::numeric_limits<float>::infinity();
+    for (const Hypothesis& candidate : candidates)
+        best = std::max(best, candidate.score);
+    for (Hypothesis& candidate : candidates)
+        candidate.score -= best;
+}
+
+bool FixedLagDecoder::isBeat(int32_t state, bool& is_downbeat) const
+{
+    const Block& block = blocks[state_block[state]];
+    const int position = state - block.first;
+    is_downbeat = position == 0;
+    return position % block.interval == 0;
+}
+
+bool FixedLagDecoder::process(const float* activations, double time, double& beat_time, float& activation, bool& is_downbeat)
+{
+    if (num_states == 0)
+        return false;
+    if (flushing)
+        reset();
+
+    const float observation[3] = {
+        std::log(std::max(activations[2], MIN_ACTIVATION) / (OBSERVATION_LAMBDA - 1)),
+        std::log(std::max(activations[0], MIN_ACTIVATION)),
+        std::log(std::max(activations[1], MIN_ACTIVATION))
+    };
+
+    expand();
+    for (Hypothesis& candidate : candidates)
+        candidate.score += observation[state_observation[candidate.state]];
+    prune();
+    std::swap(active, candidates);
+
+    Frame& frame = frameAt(frames_seen);
+    frame.states.resize(active.size());
+    frame.back.resize(active.size());
+    for (size_t i = 0; i < active.size(); ++i) {
+        frame.states[i] = active[i].state;
+        frame.back[i] = active[i].back;
+    }
+    frame.time = time;
+    frame.activation = std::max(activations[0], activations[1]);
+    frames_seen++;
+
+    // walk the best path back over the frames since the last emitted beat, up to beat_window frames before the
+    // one being decided; a beat the path moved there after its frame was decided is emitted late, not dropped
+    const long long decided = frames_seen - 1 - lag_frames;
+    if (decided < 0)
+        return false;
+    const long long oldest = std::max({ 0LL, decided - beat_window, last_beat_frame + 1 });
+    int32_t index = 0;
+    for (int32_t i = 1; i < static_cast<int32_t>(active.size()); ++i)
+        if (active[i].score > active[index].score)
+            index = i;
+    path.clear();
+    for (long long f = frames_seen - 1; f >= oldest; --f) {
+        const Frame& walked = frameAt(f);
+        path.push_back(walked.states[index]);
+        index = walked.back[index];
+    }
+
+    // path runs from the newest frame back to `oldest`
+    for (long long f = oldest; f <= decided; ++f) {
+        bool downbeat;
+        if (!isBeat(path[static_cast<size_t>(frames_seen - 1 - f)], downbeat) || f - last_beat_frame < min_beat_gap)
+            continue;
+        const Frame& beat_frame = frameAt(f);
+        beat_time = beat_frame.time;
+        activation = beat_frame.activation;
+        is_downbeat = downbeat;
+        last_beat_frame = f;
+        return true;
+    }
+    return false;
+}
+
+bool FixedLagDecoder::flush(double& beat_time, float& activation, bool& is_downbeat)
+{
+    if (frames_seen == 0)
+        return false;
+    if (!flushing) {
+        // best final path over the frames not decided yet
+        flushing = true;
+        flush_frame = std::max({ 0LL, frames_seen - lag_frames - beat_window, last_beat_frame + 1 });
+        int32_t index = 0;
+        for (int32_t i = 1; i < static_cast<int32_t>(active.size()); ++i)
+            if (active[i].score > active[index].score)
+                index = i;
+        path.clear();
+        for (long long f = frames_seen - 1; f >= flush_frame; --f) {
+            const Frame& walked = frameAt(f);
+            path.push_back(walked.states[index]);
+            index = walked.back[index];
+        }
+    }
+
+    for (; flush_frame < frames_seen; ++flush_frame) {
+        bool downbeat;
+        if (!isBeat(path[static_cast<size_t>(frames_seen - 1 - flush_frame)], downbeat) || flush_frame - last_beat_frame < min_beat_gap)
+            continue;
+        const Frame& beat_frame = frameAt(flush_frame);
+        beat_time = beat_frame.time;
+        activation = beat_frame.activation;
+        is_downbeat = downbeat;
+        last_beat_frame = flush_frame++;
+        return true;
+    }
+    reset();
+    return false;
+}
+
+double FixedLagDecoder::tempo() const
+{
+    if (active.empty())
+        return 0.0;
+    size_t best = 0;
+    for (size_t i = 1; i < active.size(); ++i)
+        if (active[i].score > active[best].score)
+            best = i;
+    return 60.0 * frame_rate / blocks[state_block[active[best].state]].interval;
+}
@@ -0,0 +1,108 @@
+#ifndef FIXED_LAG_DECODER_H
+#define FIXED_LAG_DECODER_H
+
+#include <cstdint>
+#include <vector>
+
+// Beat and downbeat decoding over the bar pointer state space of madmom's DBNDownBeatTrackingProcessor (the
+// offline decoder of the Python BeatNet), run as a fixed-lag smoother: a beam-pruned Viterbi forward pass per
+// frame and a backtrack over the last `lag` frames, so the beat decided for the frame `lag` frames ago has
+// seen that much of the future. A lag of 0 decides on the current best state, as causal as the peak picker;
+// 1-2 s come close to the offline result.
+//
+// States are (meter, beat interval, position in the bar) for 2, 3 and 4 beats per bar and 55-215 BPM at
+// 50 frames per second. The position advances by one frame per frame, the tempo may only change at a beat,
+// and the meter never changes (as in madmom, every meter is its own model and the best one wins).
+//
+// All memory is allocated by configure(); memory and per-frame cost are O(lag * beam), the per-frame cost
+// of the forward pass is O(beam). setBeamWidth() trades accuracy for time without allocating.
+class FixedLagDecoder {
+public:
+    FixedLagDecoder();
+
+    // Allocates, not real time safe. Resets the decoder.
+    void configure(int lag_frames, int max_beam, double frame_rate = 50.0, double min_bpm = 55.0, double max_bpm = 215.0);
+    void reset();
+
+    // hypotheses kept per frame, at most the max_beam of configure()
+    void setBeamWidth(int beam);
+    int beamWidth() const;
+    int lag() const;
+
+    // Feeds the [beat, downbeat, non-beat] activations of the frame centred at `time`. Returns whether the frame
+    // `lag` frames back is a beat, with its time and activation and whether it starts a bar. A beat the best path
+    // moved further back since is returned late (with its own time), one per call, rather than dropped.
+    bool process(const float* activations, double time, double& beat_time, float& activation, bool& is_downbeat);
+
+    // At the end of the stream: call until it returns false to get the beats of the last `lag` frames, decided
+    // on the best final path. Resets the decoder afterwards.
+    bool flush(double& beat_time, float& activation, bool& is_downbeat);
+
+    // tempo of the current best hypothesis in beats per minute, 0 before the first frame
+    double tempo() const;
+
+    // number of states of the full state space
+    int numStates() const;
+
+private:
+    struct Hypothesis {
+        float score;
+        int32_t state;
+        int32_t back;   // index of the predecessor in the previous frame's hypotheses
+    };
+
+    // one (meter, interval) pair: states first .. first + beats * interval - 1
+    struct Block {
+        int beats;
+        int interval;
+        int tempo;      // index of the interval
+        int first;
+    };
+
+    struct TempoTransition {
+        int to;         // tempo index
+        float log_probability;
+    };
+
+    struct Frame {
+        std::vector<int32_t> states;
+        std::vector<int32_t> back;
+        double time;
+        float activation;
+    };
+
+    // successors of the active hypotheses, the best predecessor per state
+    void expand();
+    // keeps the best `beam` candidates, scores relative to the best one
+    void prune();
+    bool isBeat(int32_t state, bool& is_downbeat) const;
+    Frame& frameAt(long long frame);
+    const Frame& frameAt(long long frame) const;
+
+    double frame_rate;
+    int lag_frames;
+    int max_beam;
+    int beam;
+
+    std::vector<Block> blocks;
+    std::vector<int> intervals;
+    std::vector<uint16_t> state_block;
+    std::vector<uint8_t> state_observation;     // 0 no beat, 1 beat, 2 downbeat
+    std::vector<std::vector<TempoTransition>> tempo_transitions;
+    std::vector<int32_t> slot;                  // candidate index of a state during expand(), -1 otherwise
+    int num_states;
+
+    std::vector<Hypothesis> active;
+    std::vector<Hypothesis> candidates;
+    std::vector<Frame> history;                 // ring of lag + beat_window + 1 frames
+    long long frames_seen;
+    long long last_beat_frame;
+    int min_beat_gap;
+    int beat_window;                            // frames before the decided one still searched for beats
+
+    std::vector<int32_t> path;                  // states of the best path, newest frame first
+    bool flushing;
+    long long flush_frame;
+};
+
+#endif
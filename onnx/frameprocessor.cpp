@@ -5,33 +5,52 @@
 FramedSignalProcessor::FramedSignalProcessor(int frameSize, int hopSize)
     : frame_size(frameSize),
       hop_size(hopSize),
-      ring_size(frame_size*1.1),            // make it a litle bit longer
+      ring_size(frameSize),
       write_pos(0),
-      ring_buffer(ring_size, 0.0f),
-      total_samples_written(0){}
+      total_samples_written(0),
+      next_frame_end(frameSize - frameSize / 2),   // the first frame is centred at sample 0
+      frame_index(-1),
+      ring_buffer(ring_size, 0.0f){}
 
 void FramedSignalProcessor::reset() {
     std::fill(ring_buffer.begin(), ring_buffer.end(), 0.0f);
     write_pos = 0;
     total_samples_written = 0;
+    next_frame_end = frame_size - frame_size / 2;
+    frame_index = -1;
 }
 
-bool FramedSignalProcessor::process(const std::vector<float>& input, std::vector<float>& frame_out) {
+int FramedSignalProcessor::process(const float* input, int num_samples, std::vector<float>& frame_out, bool& frame_ready) {
 
-    for (float sample : input) {
-        ring_buffer[write_pos] = sample;
+    // never read past the end of the next frame, so that the ring only needs to hold one frame
+    int to_consume = static_cast<int>(std::min<size_t>(num_samples, next_frame_end - total_samples_written));
+    for (int i = 0; i < to_consume; ++i) {
+        ring_buffer[write_pos] = input[i];
         write_pos = (write_pos + 1) % ring_size;
-        total_samples_written++;
     }
+    total_samples_written += to_consume;
 
-    if (total_samples_written>=frame_size)
+    frame_ready = total_samples_written == next_frame_end;
+    if (frame_ready)
     {
+        // write_pos points at the oldest sample of the ring, copy out in chronological order
         frame_out.resize(frame_size);
-        for (int i = 0; i < frame_size; ++i) {
-            int index = (write_pos + ring_size - frame_size + i) % ring_size;
-            frame_out[i] = ring_buffer[index];
-        }
-        return true;
+        std::copy(ring_buffer.begin() + write_pos, ring_buffer.end(), frame_out.begin());
+        std::copy(ring_buffer.begin(), ring_buffer.begin() + write_pos, frame_out.begin() + (ring_size - write_pos));
+        next_frame_end += hop_size;
+        frame_index++;
     }
-    else return false;
-}
\ No newline at end of file
+    return to_consume;
+}
+
+long long FramedSignalProcessor::frameIndex() const {
+    return frame_index;
+}
+
+long long FramedSignalProcessor::frameCentre() const {
+    return frame_index * hop_size;
+}
+
+long long FramedSignalProcessor::samplesWritten() const {
+    return static_cast<long long>(total_samples_written);
+}
@@ -2,22 +2,35 @@
 #define FRAMEPROCESSOR_H
 
 #include <vector>
+#include <cstddef>
 
 class FramedSignalProcessor {
 public:
     FramedSignalProcessor(int frameSize, int hopSize);
 
-    bool process(const std::vector<float>& input, std::vector<float>& frame_out);
+    // Consumes input up to the next hop boundary and returns the number of samples consumed.
+    // frame_ready is set when a complete frame has been copied into frame_out.
+    // Frames are centred on multiples of the hop size (frame k is centred at sample k*hopSize),
+    // the samples preceding the start of the signal are zeros.
+    int process(const float* input, int num_samples, std::vector<float>& frame_out, bool& frame_ready);
 
     void reset();
 
+    // index of the last emitted frame (-1 before the first one)
+    long long frameIndex() const;
+    // position of the centre of the last emitted frame, in samples of the framed signal
+    long long frameCentre() const;
+    // total number of samples pushed so far
+    long long samplesWritten() const;
+
 private:
-    int sample_rate;
     int frame_size;
     int hop_size;
     int ring_size;
     int write_pos;
     size_t total_samples_written;
+    size_t next_frame_end;
+    long long frame_index;
 
     std::vector<float> ring_buffer;
 };
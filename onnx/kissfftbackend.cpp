@@ -0,0 +1,77 @@
+#ifdef ENABLE_KISSFFT
+
+#include "kissfftbackend.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+
+KissFFTBackend::KissFFTBackend(int size):
+    fft_size(size),
+    fft_input(size, 0.0f)
+{
+    if (fft_size % 2 == 0) {
+        fftr_cfg = kiss_fftr_alloc(fft_size, 0, nullptr, nullptr);
+        fft_output.resize(fft_size / 2 + 1);
+    } else {
+        fft_cfg = kiss_fft_alloc(fft_size, 0, nullptr, nullptr);
+        complex_input.resize(fft_size);
+        fft_output.resize(fft_size);
+    }
+}
+
+KissFFTBackend::~KissFFTBackend()
+{
+    if (fftr_cfg)
+        free(fftr_cfg);
+    if (fft_cfg)
+        free(fft_cfg);
+}
+
+FFTBackendType KissFFTBackend::type() const
+{
+    return FFTBackendType::KissFFT;
+}
+
+int KissFFTBackend::size() const
+{
+    return fft_size;
+}
+
+float* KissFFTBackend::input()
+{
+    return fft_input.data();
+}
+
+void KissFFTBackend::magnitudes(float* output, int num_bins)
+{
+    transform(fft_input.data(), output, num_bins);
+}
+
+void KissFFTBackend::magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                                     float* output, int output_stride, int num_bins)
+{
+    // kiss_fftr has no many-transform plan, but it reads its input in place, so the frames are not copied
+    for (int frame = 0; frame < num_frames; ++frame)
+        transform(frames + static_cast<size_t>(frame) * input_stride, output + static_cast<size_t>(frame) * output_stride, num_bins);
+}
+
+void KissFFTBackend::transform(const float* frame, float* output, int num_bins)
+{
+    if (fftr_cfg) {
+        kiss_fftr(fftr_cfg, frame, fft_output.data());
+    } else {
+        for (int i = 0; i < fft_size; ++i) {
+            complex_input[i].r = frame[i];
+            complex_input[i].i = 0.0f;
+        }
+        kiss_fft(fft_cfg, complex_input.data(), fft_output.data());
+    }
+
+    for (int i = 0; i < num_bins; ++i) {
+        float real = fft_output[i].r;
+        float imag = fft_output[i].i;
+        output[i] = std::sqrt(real * real + imag * imag);
+    }
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef KISSFFT_BACKEND_H
+#define KISSFFT_BACKEND_H
+
+#include <vector>
+#include <kiss_fft.h>
+#include <kiss_fftr.h>
+#include "fftbackend.h"
+
+// KissFFT. Even sizes use the real transform, odd sizes (e.g. an unpadded 1411 sample frame)
+// go through the mixed-radix complex transform.
+class KissFFTBackend : public FFTBackend {
+public:
+    explicit KissFFTBackend(int size);
+    ~KissFFTBackend() override;
+
+    FFTBackendType type() const override;
+    int size() const override;
+    float* input() override;
+    void magnitudes(float* output, int num_bins) override;
+    void magnitudesBatch(const float* frames, int num_frames, int input_stride,
+                         float* output, int output_stride, int num_bins) override;
+
+private:
+    void transform(const float* frame, float* output, int num_bins);
+
+    int fft_size;
+    kiss_fftr_cfg fftr_cfg = nullptr;
+    kiss_fft_cfg fft_cfg = nullptr;
+    std::vector<kiss_fft_scalar> fft_input;
+    std::vector<kiss_fft_cpx> complex_input;
+    std::vector<kiss_fft_cpx> fft_output;
+};
+
+#endif
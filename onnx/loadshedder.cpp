@@ -0,0 +1,94 @@
+#include "loadshedder.h"
+
+LoadShedder::LoadShedder(int max_level, int recovery_blocks):
+    enabled(false),
+    budget(0.5),
+    max_level(max_level),
+    recovery_blocks(recovery_blocks)
+{
+    reset();
+}
+
+void LoadShedder::configure(bool enabled, double budget)
+{
+    this->enabled = enabled;
+    this->budget = budget;
+    if (!enabled)
+        current_level.store(0, std::memory_order_relaxed);
+}
+
+bool LoadShedder::isEnabled() const
+{
+    return enabled;
+}
+
+void LoadShedder::reset()
+{
+    calm_blocks = 0;
+    current_level.store(0, std::memory_order_relaxed);
+    last_load.store(0.0, std::memory_order_relaxed);
+    deadline_misses.store(0, std::memory_order_relaxed);
+    saturated_misses.store(0, std::memory_order_relaxed);
+}
+
+void LoadShedder::update(double elapsed, double deadline)
+{
+    if (deadline <= 0.0)
+        return;
+
+    double load = elapsed / deadline;
+    int level = current_level.load(std::memory_order_relaxed);
+    last_load.store(load, std::memory_order_relaxed);
+    if (load > 1.0) {
+        deadline_misses.fetch_add(1, std::memory_order_relaxed);
+        if (enabled && level == max_level)
+            saturated_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!enabled)
+        return;
+
+    if (load > budget) {
+        calm_blocks = 0;
+        if (level < max_level)
+            current_level.store(level + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    // inference dominates the cost, so one level down runs the model (level + 1) / level times as often;
+    // step down once that estimate has stayed comfortably within the budget
+    double load_one_level_down = level > 0 ? load * (level + 1) / level : load;
+    if (level > 0 && load_one_level_down < 0.8 * budget) {
+        if (++calm_blocks >= recovery_blocks) {
+            current_level.store(level - 1, std::memory_order_relaxed);
+            calm_blocks = 0;
+        }
+    } else {
+        calm_blocks = 0;
+    }
+}
+
+bool LoadShedder::shouldRun(long long frame_index) const
+{
+    int level = current_level.load(std::memory_order_relaxed);
+    return level == 0 || frame_index % (level + 1) == 0;
+}
+
+int LoadShedder::level() const
+{
+    return current_level.load(std::memory_order_relaxed);
+}
+
+double LoadShedder::load() const
+{
+    return last_load.load(std::memory_order_relaxed);
+}
+
+long long LoadShedder::deadlineMisses() const
+{
+    return deadline_misses.load(std::memory_order_relaxed);
+}
+
+long long LoadShedder::saturatedMisses() const
+{
+    return saturated_misses.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+#ifndef LOAD_SHEDDER_H
+#define LOAD_SHEDDER_H
+
+#include <atomic>
+
+// Keeps the cost of BeatNet::process within a share of the block deadline on busy hosts.
+// The level says how many hops in a row skip inference: at level n the model only runs on every
+// (n + 1)th hop and the hops in between repeat its last output. They are not interpolated between the
+// neighbouring model outputs, which would hold every hop back until the next model run. Features are
+// still computed for every hop, so the spectral difference history stays intact. Higher levels are entered as soon as a block
+// takes longer than the budget, and left once the blocks would fit at the lower level again for a while.
+class LoadShedder {
+public:
+    // disabled by default
+    LoadShedder(int max_level = 3, int recovery_blocks = 50);
+
+    // budget: share of the block duration process() may use, e.g. 0.5
+    void configure(bool enabled, double budget);
+    bool isEnabled() const;
+
+    // elapsed: time spent processing the block, deadline: its duration, both in seconds
+    void update(double elapsed, double deadline);
+    void reset();
+
+    // whether the hop with this index runs the model at the current level
+    bool shouldRun(long long frame_index) const;
+
+    // may be read from any thread
+    int level() const;
+    double load() const;             // elapsed / deadline of the last block
+    long long deadlineMisses() const; // blocks that took longer than their duration
+    long long saturatedMisses() const; // of those, blocks processed at max_level, with nothing left to shed
+
+private:
+    bool enabled;
+    double budget;
+    int max_level;
+    int recovery_blocks;
+    int calm_blocks;
+
+    std::atomic<int> current_level;
+    std::atomic<double> last_load;
+    std::atomic<long long> deadline_misses;
+    std::atomic<long long> saturated_misses;
+};
+
+#endif
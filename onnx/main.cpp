@@ -1,12 +1,350 @@
 #include "BeatNet.h"
+#include "offlineanalyzer.h"
+#include "tracereplayer.h"
+#include "beatmetrics.h"
+#include "fftprocessor.h"
+#include "filterbankprocessor.h"
+#include "frameprocessor.h"
+#include "logspecutils.h"
+#include "rtlog.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <iterator>
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <random>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 float randomFloatGenerator() {
     return static_cast<float>(rand()) / RAND_MAX;
 }
 
-int main() {
-    
+// resident set size of the process, 0 where /proc is not available
+long long residentBytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    long long pages = 0, resident = 0;
+    if (statm >> pages >> resident)
+        return resident * sysconf(_SC_PAGESIZE);
+#endif
+    return 0;
+}
+
+// Counts one hardware event of the calling thread between start() and stop(), -1 where perf events are not
+// available (not Linux, no PMU in a VM, perf_event_paranoid too strict)
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config) {
+#ifdef __linux__
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~PerfCounter() {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    long long stop() {
+#ifdef __linux__
+        long long count = 0;
+        if (fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(fd, &count, sizeof(count)) == sizeof(count))
+            return count;
+#endif
+        return -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+// 16 bit or float PCM WAV, channels averaged to mono
+bool readWav(const std::string& path, std::vector<float>& audio, double& sampleRate) {
+    std::ifstream file(path, std::ios::binary);
+    char riff[12];
+    if (!file.read(riff, 12) || std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        std::cerr << path << " is not a WAV file\n";
+        return false;
+    }
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    char id[4];
+    uint32_t size;
+    while (file.read(id, 4) && file.read(reinterpret_cast<char*>(&size), 4)) {
+        if (std::memcmp(id, "fmt ", 4) == 0) {
+            std::vector<char> chunk(size);
+            file.read(chunk.data(), size);
+            std::memcpy(&format, chunk.data(), 2);
+            std::memcpy(&channels, chunk.data() + 2, 2);
+            std::memcpy(&rate, chunk.data() + 4, 4);
+            std::memcpy(&bits, chunk.data() + 14, 2);
+            if (format == 0xfffe && size >= 26) {
+                std::memcpy(&format, chunk.data() + 24, 2); // WAVE_FORMAT_EXTENSIBLE sub format
+            }
+        } else if (std::memcmp(id, "data", 4) == 0) {
+            bool pcm16 = format == 1 && bits == 16, float32 = format == 3 && bits == 32;
+            if (!channels || !(pcm16 || float32)) {
+                std::cerr << path << ": only 16 bit PCM and 32 bit float WAV files are supported\n";
+                return false;
+            }
+            std::vector<char> data(size);
+            file.read(data.data(), size);
+            const size_t frames = size / (bits / 8) / channels;
+            audio.assign(frames, 0.0f);
+            for (size_t frame = 0; frame < frames; ++frame) {
+                for (int channel = 0; channel < channels; ++channel) {
+                    size_t index = frame * channels + channel;
+                    float sample;
+                    if (pcm16) {
+                        int16_t value;
+                        std::memcpy(&value, data.data() + 2 * index, 2);
+                        sample = value / 32768.0f;
+                    } else {
+                        std::memcpy(&sample, data.data() + 4 * index, 4);
+                    }
+                    audio[frame] += sample / channels;
+                }
+            }
+            sampleRate = rate;
+            return true;
+        } else {
+            file.seekg(size + (size & 1), std::ios::cur);
+        }
+    }
+    std::cerr << path << " has no audio data\n";
+    return false;
+}
+
+// one beat per line: time in seconds, optionally followed by the position in the bar (1 = downbeat)
+bool readAnnotations(const std::string& path, std::vector<double>& beats, std::vector<double>& downbeats) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot read " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        double time, position;
+        if (!(fields >> time)) {
+            continue;
+        }
+        beats.push_back(time);
+        if (fields >> position && static_cast<int>(position) == 1) {
+            downbeats.push_back(time);
+        }
+    }
+    return !beats.empty();
+}
+
+// activation file as written by OfflineAnalyzer and referenceActivations.py
+bool readActivations(const std::string& path, std::vector<float>& activations) {
+    std::ifstream file(path, std::ios::binary);
+    ActivationFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "BNACTIV", 8) != 0
+        || header.num_classes != 3) {
+        std::cerr << path << " is not an activation file\n";
+        return false;
+    }
+    activations.resize(header.num_frames * header.num_classes);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(activations.data()), activations.size() * sizeof(float)));
+}
+
+struct Evaluation {
+    double beatF, downbeatF;
+    BeatMetrics::Continuity continuity;
+    double tempo, annotatedTempo;
+    bool tempoOk;
+    double realtimeFactor;
+    std::vector<float> activations;
+};
+
+// runs a track through the streaming pipeline in 512 frame blocks and scores the beats it reports;
+// lagSeconds >= 0 decides the beats with the fixed-lag decoder instead of the peak picker
+Evaluation evaluateTrack(const std::vector<float>& audio, double sampleRate, const std::vector<double>& beats,
+                         const std::vector<double>& downbeats, double lagSeconds = -1.0) {
+    const int evalBlockSize = 512;
+    BeatNet tracker;
+    tracker.setup(sampleRate, evalBlockSize);
+    if (lagSeconds >= 0.0) {
+        tracker.setFixedLagDecoding(true, lagSeconds);
+    }
+    std::vector<float> evalBlock(evalBlockSize), evalOutput(3);
+    std::vector<BeatEvent> evalEvents;
+    evalEvents.reserve(16);
+    std::vector<double> detectedBeats, detectedDownbeats;
+    Evaluation result {};
+
+    double seconds = 0.0;
+    size_t lastBlockStart = 0;
+    auto collect = [&](size_t blockStart) {
+        for (const BeatEvent& event : evalEvents) {
+            double time = (static_cast<double>(blockStart) + event.sample) / sampleRate;
+            detectedBeats.push_back(time);
+            if (event.downbeat) {
+                detectedDownbeats.push_back(time);
+            }
+        }
+    };
+    for (size_t blockStart = 0; blockStart < audio.size(); blockStart += evalBlockSize) {
+        size_t frames = std::min<size_t>(evalBlockSize, audio.size() - blockStart);
+        evalBlock.assign(audio.begin() + blockStart, audio.begin() + blockStart + frames);
+        auto begin = std::chrono::steady_clock::now();
+        tracker.process(evalBlock, evalOutput, evalEvents, result.activations);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        collect(blockStart);
+        lastBlockStart = blockStart;
+    }
+    if (lagSeconds >= 0.0) {
+        // the beats of the last lagSeconds, positioned relative to the last block
+        std::vector<float> remaining;
+        tracker.finish(evalEvents, remaining);
+        collect(lastBlockStart);
+    }
+
+    std::vector<double> annotated = BeatMetrics::trim(beats), detected = BeatMetrics::trim(detectedBeats);
+    result.beatF = BeatMetrics::fMeasure(annotated, detected);
+    result.downbeatF = BeatMetrics::fMeasure(BeatMetrics::trim(downbeats), BeatMetrics::trim(detectedDownbeats));
+    result.continuity = BeatMetrics::continuity(annotated, detected);
+    result.tempo = tracker.getStableTempo();
+    result.annotatedTempo = BeatMetrics::annotatedTempo(beats);
+    result.tempoOk = BeatMetrics::tempoMatches(result.tempo, result.annotatedTempo);
+    result.realtimeFactor = seconds > 0.0 ? audio.size() / sampleRate / seconds : 0.0;
+    return result;
+}
+
+void printEvaluation(const std::string& name, const Evaluation& result) {
+    std::cout << name << ": beat F " << result.beatF << ", downbeat F " << result.downbeatF
+              << ", CMLt " << result.continuity.cmlt << ", AMLt " << result.continuity.amlt
+              << ", tempo " << result.tempo << " bpm (annotated " << result.annotatedTempo << (result.tempoOk ? ", ok" : ", WRONG")
+              << "), " << result.realtimeFactor << "x real time\n";
+}
+
+// the scores a track needs to pass, used by --eval and the synthetic kick of the default run
+struct Thresholds {
+    double minFMeasure = 0.8, minDownbeatF = 0.5, minCmlt = 0.6, minAmlt = 0.8, minRealtime = 1.0;
+    bool checkTempo = true;
+};
+
+// reports every measure below its threshold
+bool meetsThresholds(const Evaluation& result, const Thresholds& thresholds) {
+    bool met = true;
+    auto require = [&met](bool ok, const char* what) {
+        if (!ok) {
+            std::cout << "  " << what << " below threshold\n";
+            met = false;
+        }
+    };
+    require(result.beatF >= thresholds.minFMeasure, "beat F");
+    require(result.downbeatF >= thresholds.minDownbeatF, "downbeat F");
+    require(result.continuity.cmlt >= thresholds.minCmlt, "CMLt");
+    require(result.continuity.amlt >= thresholds.minAmlt, "AMLt");
+    require(result.tempoOk || !thresholds.checkTempo, "tempo");
+    require(result.realtimeFactor >= thresholds.minRealtime, "real time factor");
+    return met;
+}
+
+// beatnet_infer --eval [--min-fmeasure F] [--min-downbeat-fmeasure F] [--min-cmlt C] [--min-amlt A] [--ignore-tempo]
+//                      [--max-error E] [--min-xrt X] track.wav track.beats [reference.activations] ...
+// Fails (exit code 1) when a track scores below any of the thresholds, gets the tempo wrong (unless ignored), its
+// activations deviate from the Python reference (see referenceActivations.py) by more than the mean error or the
+// reference cannot be read, or it runs slower than the real time factor.
+int evaluate(int argc, char** argv) {
+    Thresholds thresholds;
+    double maxError = 0.02;
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--min-fmeasure" && i + 1 < argc) {
+            thresholds.minFMeasure = std::atof(argv[++i]);
+        } else if (argument == "--min-downbeat-fmeasure" && i + 1 < argc) {
+            thresholds.minDownbeatF = std::atof(argv[++i]);
+        } else if (argument == "--min-cmlt" && i + 1 < argc) {
+            thresholds.minCmlt = std::atof(argv[++i]);
+        } else if (argument == "--min-amlt" && i + 1 < argc) {
+            thresholds.minAmlt = std::atof(argv[++i]);
+        } else if (argument == "--ignore-tempo") {
+            thresholds.checkTempo = false;
+        } else if (argument == "--max-error" && i + 1 < argc) {
+            maxError = std::atof(argv[++i]);
+        } else if (argument == "--min-xrt" && i + 1 < argc) {
+            thresholds.minRealtime = std::atof(argv[++i]);
+        } else {
+            files.push_back(argument);
+        }
+    }
+
+    bool passed = true;
+    for (size_t i = 0; i + 1 < files.size();) {
+        const std::string audioPath = files[i], annotationPath = files[i + 1];
+        i += 2;
+        std::string referencePath;
+        if (i < files.size() && files[i].size() > 12 && files[i].compare(files[i].size() - 12, 12, ".activations") == 0) {
+            referencePath = files[i++];
+        }
+
+        std::vector<float> audio;
+        std::vector<double> beats, downbeats;
+        double trackRate = 0.0;
+        if (!readWav(audioPath, audio, trackRate) || !readAnnotations(annotationPath, beats, downbeats)) {
+            passed = false;
+            continue;
+        }
+        Evaluation result = evaluateTrack(audio, trackRate, beats, downbeats);
+        printEvaluation(audioPath, result);
+        bool trackPassed = meetsThresholds(result, thresholds);
+
+        std::vector<float> reference;
+        if (!referencePath.empty() && !readActivations(referencePath, reference)) {
+            std::cout << "  reference activations " << referencePath << " unreadable\n";
+            trackPassed = false;
+        } else if (!referencePath.empty()) {
+            BeatMetrics::ActivationError error = BeatMetrics::compareActivations(reference, result.activations);
+            std::cout << "  activations vs. reference: mean error " << error.mean_error << ", max " << error.max_error
+                      << " over " << error.frames << " frames at lag " << error.lag << "\n";
+            trackPassed = trackPassed && error.mean_error <= maxError;
+        }
+        std::cout << "  " << (trackPassed ? "PASS" : "FAIL") << "\n";
+        passed = passed && trackPassed;
+    }
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--eval") {
+        return evaluate(argc, argv);
+    }
+    // the checks below clear this, the exit code is 1 when one failed
+    bool passed = true;
+
     BeatNet tracker;
     tracker.setup(44000, 512);
 
@@ -29,5 +367,802 @@ int main() {
             std::cout << "]\n";
         }
     }
-    return 0;
+
+    // setup() called thousands of times from a control thread while this thread keeps calling process(). Every
+    // block must have run with one of the published rates and resampled to the length that rate implies (no torn
+    // state), and the hops must match the same resampled signal fed through a tracker that was never
+    // reconfigured: same frame centres, features and outputs, i.e. framer, features and LSTM state carried over
+    // every switch. A crash ends the program with a signal.
+    // The host blocks are long enough that any two of the rates give resampled lengths further apart than the
+    // few samples a converter holds back after a switch.
+    {
+        const double swapRates[] = { 16000.0, 44100.0, 96000.0, 192000.0 };
+        const int swapBlockSizes[] = { 64, 256, 480, 1024 };
+        const int swapSetups = 5000;
+        const int swapHostBlock = 1024;
+        BeatNet swapped;
+        swapped.setup(44100.0, swapHostBlock);
+        TraceRecorder swapRecorder;
+        bool tracesOpened = swapRecorder.open("swaps.trace", TraceAudio);
+        swapped.setTraceRecorder(&swapRecorder);
+
+        std::atomic<bool> setupsDone { false };
+        std::atomic<int> failedSetups { 0 };
+        std::thread control([&] {
+            for (int i = 0; i < swapSetups; ++i) {
+                if (!swapped.setup(swapRates[i % 4], swapBlockSizes[(i / 4) % 4]))
+                    failedSetups++;
+                std::this_thread::yield();
+            }
+            setupsDone = true;
+        });
+        std::vector<float> swapBlock(swapHostBlock), swapOutput(3);
+        std::vector<BeatEvent> swapEvents;
+        swapEvents.reserve(16);
+        long long swapBlocks = 0;
+        // until the control thread is done, then 50 more blocks with the last configuration
+        for (int tail = 0; tail < 50; ++swapBlocks) {
+            if (setupsDone) {
+                tail++;
+            }
+            for (int n = 0; n < swapHostBlock; ++n) {
+                long long phase = (swapBlocks * swapHostBlock + n) % 22050;
+                swapBlock[n] = phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f;
+            }
+            swapped.process(swapBlock, swapOutput, swapEvents);
+            // keeps the trace small while the control thread swaps several times per block
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        control.join();
+        swapped.setTraceRecorder(nullptr);
+        swapRecorder.close();
+
+        TraceReader swapTrace;
+        tracesOpened = swapTrace.open("swaps.trace") && tracesOpened;
+        TraceRecorder referenceRecorder;
+        tracesOpened = referenceRecorder.open("swaps_reference.trace", 0) && tracesOpened;
+        BeatNet reference;
+        reference.setup(44100.0, swapHostBlock);
+        reference.setTraceRecorder(&referenceRecorder);
+        std::vector<float> referenceActivations;
+        const double sampleTolerance = 64.0;
+        int unknownRates = 0, wrongLengths = 0, rateChanges = 0;
+        double lastRate = 0.0;
+        for (size_t i = 0; i < swapTrace.numBlocks(); ++i) {
+            const TraceReader::Block traceBlock = swapTrace.block(i);
+            const TraceBlock& info = *traceBlock.info;
+            if (std::find(std::begin(swapRates), std::end(swapRates), info.sample_rate) == std::end(swapRates)) {
+                unknownRates++;
+            }
+            if (info.sample_rate != lastRate) {
+                rateChanges++;
+                lastRate = info.sample_rate;
+            }
+            if (std::abs(info.num_samples - info.num_frames * SR_BEATNET / info.sample_rate) > sampleTolerance) {
+                wrongLengths++;
+            }
+
+            referenceRecorder.beginBlock(info.sample_rate, info.num_frames, 1);
+            referenceActivations.clear();
+            reference.replaySamples(traceBlock.samples, static_cast<int>(info.num_samples), info.num_frames, swapOutput,
+                                    swapEvents, referenceActivations);
+            referenceRecorder.endBlock(0.0);
+        }
+        reference.setTraceRecorder(nullptr);
+        referenceRecorder.close();
+        TraceReader referenceTrace;
+        tracesOpened = referenceTrace.open("swaps_reference.trace") && tracesOpened;
+
+        std::cout << "Setup swaps: " << swapSetups << " setups (" << failedSetups << " failed), " << rateChanges
+                  << " rate changes over " << swapTrace.numBlocks() << " blocks, " << unknownRates << " with an unknown rate, "
+                  << wrongLengths << " resampled to the wrong length; ";
+        bool continuous = compareTraces(swapTrace, referenceTrace, 1e-5f, std::cout);
+        bool swapsPassed = tracesOpened && failedSetups == 0 && unknownRates == 0 && swapTrace.numBlocks() > 0
+                           && wrongLengths == 0 && continuous;
+        std::cout << "Setup swaps " << (swapsPassed ? "PASS" : "FAIL") << "\n";
+        passed = passed && swapsPassed;
+        std::remove("swaps.trace");
+        std::remove("swaps_reference.trace");
+    }
+
+    // synthetic 120 bpm click track, reports how far each event lands from the closest click; after latency
+    // compensation every event must be within 70 ms of a click (the window of the beat F-measure)
+    const double sampleRate = 44100;
+    const int blockSize = 512;
+    const long long clickPeriod = static_cast<long long>(sampleRate / 2);
+    BeatNet clickTracker;
+    clickTracker.setup(sampleRate, blockSize);
+    std::cout << "Pipeline latency: " << clickTracker.getLatency() << " samples\n";
+
+    std::vector<float> block(blockSize);
+    std::vector<BeatEvent> events;
+    events.reserve(16);
+    const long long eventTolerance = static_cast<long long>(0.07 * sampleRate);
+    int clickEvents = 0, misplacedEvents = 0;
+    for (long long blockStart = 0; blockStart < 20 * static_cast<long long>(sampleRate); blockStart += blockSize) {
+        for (int n = 0; n < blockSize; ++n) {
+            long long phase = (blockStart + n) % clickPeriod;
+            block[n] = phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f;
+        }
+
+        clickTracker.process(block, output, events);
+        for (const BeatEvent& event : events) {
+            long long position = blockStart + event.sample;
+            long long nearestClick = (position + clickPeriod / 2) / clickPeriod * clickPeriod;
+            std::cout << (event.downbeat ? "*beat at " : "beat at ") << position
+                      << " (error " << position - nearestClick << " samples, reported "
+                      << blockStart + blockSize - position << " samples late)\n";
+            clickEvents++;
+            if (std::abs(position - nearestClick) > eventTolerance) {
+                misplacedEvents++;
+            }
+        }
+    }
+    std::cout << "Click track: " << clickEvents << " events, " << misplacedEvents << " more than " << eventTolerance
+              << " samples from a click" << (clickEvents > 0 && misplacedEvents == 0 ? "\n" : " FAIL\n");
+    passed = passed && clickEvents > 0 && misplacedEvents == 0;
+
+    long long nextBeat;
+    if (clickTracker.predictNextBeat(nextBeat)) {
+        std::cout << "Tempo " << clickTracker.getTempo() << " bpm, next beat expected " << nextBeat << " samples after the last block start\n";
+    }
+    const double stableTempo = clickTracker.getStableTempo();
+    const bool stableTempoPassed = std::abs(stableTempo - 120.0) <= 1.0;
+    std::cout << "Stable tempo " << stableTempo << " bpm (confidence " << clickTracker.getTempoConfidence() << ")"
+              << (stableTempoPassed ? "\n" : ", expected 120 +- 1 FAIL\n");
+    passed = passed && stableTempoPassed;
+
+    // TempoEstimator alone, timed per frame over a stored 120 bpm activation sequence (50 fps, 60 s): narrow
+    // beat peaks every 25 frames, a weaker offbeat peak and some noise
+    {
+        std::vector<float> activations(50 * 60);
+        for (size_t frame = 0; frame < activations.size(); ++frame) {
+            int phase = static_cast<int>(frame % 25);
+            float peak = phase == 0 ? 0.9f : (phase == 1 || phase == 24 ? 0.3f : (phase == 12 ? 0.15f : 0.0f));
+            activations[frame] = peak + randomFloatGenerator() * 0.05f;
+        }
+        TempoEstimator estimator;
+        auto estimatorStart = std::chrono::steady_clock::now();
+        for (float activation : activations)
+            estimator.process(activation);
+        double estimatorUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - estimatorStart).count()
+                             / activations.size();
+        const bool estimatorPassed = std::abs(estimator.tempo() - 120.0) <= 1.0;
+        std::cout << "Tempo estimator: " << estimatorUs << " us/frame, " << estimator.tempo() << " bpm (confidence "
+                  << estimator.confidence() << ")" << (estimatorPassed ? "\n" : ", expected 120 +- 1 FAIL\n");
+        passed = passed && estimatorPassed;
+    }
+
+    // energy gate on alternating 5 s of clicks and 5 s of near silence: CPU time saved vs. deviation of the activations.
+    // A gated hop puts the LSTM straight into its silence state, so the activations differ while the ungated model
+    // still remembers the clicks; from 2 s into the near silence on they may only differ by what the noise does to
+    // the features.
+    BeatNet ungated, gated;
+    ungated.setup(sampleRate, blockSize);
+    gated.setup(sampleRate, blockSize);
+    gated.setEnergyGate(true);
+    std::vector<float> gatedOutput(3);
+    double ungatedSeconds = 0.0, gatedSeconds = 0.0, maxDeviation = 0.0, settledDeviation = 0.0;
+    for (long long blockStart = 0; blockStart < 30 * static_cast<long long>(sampleRate); blockStart += blockSize) {
+        bool silent = (blockStart / static_cast<long long>(5 * sampleRate)) % 2 == 1;
+        bool settled = silent && blockStart % static_cast<long long>(5 * sampleRate) >= static_cast<long long>(2 * sampleRate);
+        for (int n = 0; n < blockSize; ++n) {
+            long long phase = (blockStart + n) % clickPeriod;
+            float noise = (randomFloatGenerator() - 0.5f) * 1e-4f;
+            block[n] = silent ? noise : (phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f) + noise;
+        }
+        auto blockBegin = std::chrono::steady_clock::now();
+        bool hasOutput = ungated.process(block, output);
+        auto blockMiddle = std::chrono::steady_clock::now();
+        gated.process(block, gatedOutput);
+        auto blockEnd = std::chrono::steady_clock::now();
+        ungatedSeconds += std::chrono::duration<double>(blockMiddle - blockBegin).count();
+        gatedSeconds += std::chrono::duration<double>(blockEnd - blockMiddle).count();
+        if (hasOutput)
+            for (int i = 0; i < 3; ++i) {
+                double deviation = std::abs(output[i] - gatedOutput[i]);
+                maxDeviation = std::max(maxDeviation, deviation);
+                if (settled)
+                    settledDeviation = std::max(settledDeviation, deviation);
+            }
+    }
+    const bool gatePassed = gated.getGatedFrames() > 0 && settledDeviation <= 1e-2;
+    std::cout << "Energy gate: " << gated.getGatedFrames() << "/" << gated.getTotalFrames() << " hops gated, "
+              << ungatedSeconds << " s -> " << gatedSeconds << " s, max activation deviation " << maxDeviation
+              << ", in settled near silence " << settledDeviation << (gatePassed ? "\n" : ", expected <= 0.01 FAIL\n");
+    passed = passed && gatePassed;
+
+    // digital silence: square wave bursts every 0.5 s (any frame holding one burst sample is far above the
+    // threshold, so only frames of exact zeros are gated) alternating with 5 s of zeros, fed at 22050 Hz behind
+    // the resampler. The features of every hop must be exactly those without the gate.
+    {
+        BeatNet digitalUngated, digitalGated;
+        digitalUngated.setup(SR_BEATNET, blockSize);
+        digitalGated.setup(SR_BEATNET, blockSize);
+        digitalGated.setEnergyGate(true);
+        TraceRecorder ungatedRecorder, gatedRecorder;
+        bool tracesOpened = ungatedRecorder.open("gate_ungated.trace", 0);
+        tracesOpened = gatedRecorder.open("gate_gated.trace", 0) && tracesOpened;
+        digitalUngated.setTraceRecorder(&ungatedRecorder);
+        digitalGated.setTraceRecorder(&gatedRecorder);
+        std::vector<float> digitalBlock(blockSize), digitalOutput(3), digitalActivations;
+        std::vector<BeatEvent> digitalEvents;
+        digitalEvents.reserve(16);
+        auto feed = [&](BeatNet& tracker, TraceRecorder& recorder) {
+            recorder.beginBlock(SR_BEATNET, blockSize, 1);
+            digitalActivations.clear();
+            tracker.replaySamples(digitalBlock.data(), blockSize, blockSize, digitalOutput, digitalEvents, digitalActivations);
+            recorder.endBlock(0.0);
+        };
+        for (long long blockStart = 0; blockStart < 30LL * SR_BEATNET; blockStart += blockSize) {
+            bool silent = (blockStart / (5LL * SR_BEATNET)) % 2 == 1;
+            for (int n = 0; n < blockSize; ++n) {
+                long long phase = (blockStart + n) % (SR_BEATNET / 2);
+                digitalBlock[n] = !silent && phase < 256 ? (phase / 8 % 2 ? 0.5f : -0.5f) : 0.0f;
+            }
+            feed(digitalUngated, ungatedRecorder);
+            feed(digitalGated, gatedRecorder);
+        }
+        digitalUngated.setTraceRecorder(nullptr);
+        digitalGated.setTraceRecorder(nullptr);
+        ungatedRecorder.close();
+        gatedRecorder.close();
+
+        TraceReader ungatedTrace, gatedTrace;
+        tracesOpened = ungatedTrace.open("gate_ungated.trace") && tracesOpened;
+        tracesOpened = gatedTrace.open("gate_gated.trace") && tracesOpened;
+        bool sameHops = tracesOpened && ungatedTrace.numBlocks() == gatedTrace.numBlocks();
+        long long comparedHops = 0;
+        double featureDeviation = 0.0;
+        for (size_t i = 0; sameHops && i < ungatedTrace.numBlocks(); ++i) {
+            const TraceReader::Block ungatedBlock = ungatedTrace.block(i), gatedBlock = gatedTrace.block(i);
+            sameHops = ungatedBlock.info->num_hops == gatedBlock.info->num_hops;
+            for (uint32_t hop = 0; sameHops && hop < ungatedBlock.info->num_hops; ++hop, ++comparedHops)
+                for (int k = 0; k < FBANK_SIZE; ++k)
+                    featureDeviation = std::max(featureDeviation, static_cast<double>(std::abs(
+                        ungatedBlock.hops[hop].features[k] - gatedBlock.hops[hop].features[k])));
+        }
+        const bool digitalPassed = sameHops && comparedHops > 0 && digitalGated.getGatedFrames() > 0 && featureDeviation == 0.0;
+        std::cout << "Energy gate, digital silence: " << digitalGated.getGatedFrames() << "/" << comparedHops
+                  << " hops gated, max feature deviation " << featureDeviation << (digitalPassed ? "\n" : " FAIL\n");
+        passed = passed && digitalPassed;
+        std::remove("gate_ungated.trace");
+        std::remove("gate_gated.trace");
+    }
+
+    // load shedding: busy threads compete for every core while a small budget simulates an oversubscribed host
+    std::atomic<bool> stopLoad { false };
+    std::vector<std::thread> loadThreads;
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+        loadThreads.emplace_back([&stopLoad] { volatile double x = 0.0; while (!stopLoad) x = x + 1.0; });
+    BeatNet shedding;
+    shedding.setup(sampleRate, blockSize);
+    shedding.setLoadShedding(true, 0.02);
+    int maxLevel = 0;
+    for (long long blockStart = 0; blockStart < 10 * static_cast<long long>(sampleRate); blockStart += blockSize) {
+        for (int n = 0; n < blockSize; ++n) {
+            long long phase = (blockStart + n) % clickPeriod;
+            block[n] = phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f;
+        }
+        shedding.process(block, output);
+        maxLevel = std::max(maxLevel, shedding.getLoadLevel());
+    }
+    stopLoad = true;
+    for (std::thread& thread : loadThreads)
+        thread.join();
+    // misses while shedding is still stepping up are expected, once it is at the highest level there must be none
+    bool sheddingPassed = shedding.getSaturatedDeadlineMisses() == 0;
+    std::cout << "Load shedding: highest level " << maxLevel << ", final level " << shedding.getLoadLevel()
+              << ", last load " << shedding.getLoad() << ", deadline misses " << shedding.getDeadlineMisses()
+              << " (" << shedding.getSaturatedDeadlineMisses() << " at the highest level)" << (sheddingPassed ? "\n" : " FAIL\n");
+    passed = passed && sheddingPassed;
+
+    // tail latency of process() while every other core is busy: unpinned vs. pinned to core 0 with real-time priority
+    // (the load threads stay off core 0 in the pinned run, as on a box with an isolated audio/inference core)
+    const unsigned numCores = std::max(1u, std::thread::hardware_concurrency());
+    for (bool pinned : { false, true }) {
+        ThreadPlacement loadPlacement;
+        for (unsigned core = 1; pinned && core < numCores; ++core)
+            loadPlacement.cores.push_back(static_cast<int>(core));
+        std::atomic<bool> stopBusy { false };
+        std::vector<std::thread> busyThreads;
+        for (unsigned i = 0; i < numCores; ++i)
+            busyThreads.emplace_back([&stopBusy, loadPlacement] {
+                applyThreadPlacement(loadPlacement);
+                volatile double x = 0.0;
+                while (!stopBusy) x = x + 1.0;
+            });
+
+        std::vector<double> latencies;
+        std::thread audioThread([&] {
+            ThreadPlacement audioPlacement;
+            if (pinned) {
+                audioPlacement.cores = { 0 };
+                audioPlacement.policy = SchedulingPolicy::Fifo;
+                audioPlacement.priority = 80;
+            }
+            applyThreadPlacement(audioPlacement);
+            BeatNet placed;
+            placed.setup(sampleRate, blockSize);
+            std::vector<float> placedBlock(blockSize);
+            std::vector<float> placedOutput(3);
+            for (int i = 0; i < 2000; ++i) {
+                std::generate(placedBlock.begin(), placedBlock.end(), randomFloatGenerator);
+                auto blockBegin = std::chrono::steady_clock::now();
+                placed.process(placedBlock, placedOutput);
+                latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - blockBegin).count());
+            }
+        });
+        audioThread.join();
+        stopBusy = true;
+        for (std::thread& thread : busyThreads)
+            thread.join();
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+        std::cout << (pinned ? "Pinned" : "Unpinned") << " under load: p50 " << percentile(0.5) << " us, p99 "
+                  << percentile(0.99) << " us, p99.9 " << percentile(0.999) << " us, max " << latencies.back() << " us\n";
+    }
+
+    // process() latency while the log is quiet and while other threads and the audio thread itself log heavily;
+    // the messages go to a counting sink so that the terminal does not slow the drain down
+    std::atomic<long long> loggedMessages { 0 };
+    RTLog::setSink([&loggedMessages](LogLevel, const char*) { loggedMessages++; });
+    for (bool logging : { false, true }) {
+        std::atomic<bool> stopLogging { false };
+        std::vector<std::thread> loggers;
+        for (int i = 0; logging && i < 4; ++i)
+            loggers.emplace_back([&stopLogging, i] {
+                for (long long n = 0; !stopLogging; ++n)
+                    RTLOG_WARNING("logger %d message %lld", i, n);
+            });
+
+        BeatNet logged;
+        logged.setup(sampleRate, blockSize);
+        std::vector<double> latencies;
+        for (int i = 0; i < 2000; ++i) {
+            std::generate(block.begin(), block.end(), randomFloatGenerator);
+            auto blockBegin = std::chrono::steady_clock::now();
+            logged.process(block, output);
+            if (logging)
+                RTLOG_ERROR("block %d: %f %f %f", i, output[0], output[1], output[2]);
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - blockBegin).count());
+        }
+        stopLogging = true;
+        for (std::thread& thread : loggers)
+            thread.join();
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+        std::cout << (logging ? "Heavy logging" : "Quiet log") << ": p50 " << percentile(0.5) << " us, p99 "
+                  << percentile(0.99) << " us, max " << latencies.back() << " us\n";
+    }
+    RTLog::flush();
+    RTLog::setSink(nullptr);
+    std::cout << "Log: " << loggedMessages << " messages written, " << RTLog::droppedMessages() << " dropped\n";
+
+    // chunked offline analysis of 2 minutes of clicks, in small chunks and in one go; the files must be identical
+    auto analyzeClicks = [&](long chunkFrames, const std::string& path) {
+        long long position = 0;
+        const long long length = 120 * static_cast<long long>(sampleRate);
+        OfflineAnalyzer::Reader reader = [&](float* buffer, long maxFrames) {
+            long frames = static_cast<long>(std::min<long long>(maxFrames, length - position));
+            for (long n = 0; n < frames; ++n, ++position) {
+                long long phase = position % clickPeriod;
+                buffer[n] = phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f;
+            }
+            return frames;
+        };
+        BeatNet offlineTracker;
+        OfflineAnalyzer analyzer(offlineTracker, sampleRate, chunkFrames);
+        return analyzer.analyze(reader, path);
+    };
+    long long chunkedRows = analyzeClicks(4096, "activations_chunked.bin");
+    long long singleRows = analyzeClicks(120 * static_cast<long>(sampleRate), "activations_single.bin");
+    std::ifstream chunkedFile("activations_chunked.bin", std::ios::binary), singleFile("activations_single.bin", std::ios::binary);
+    bool identical = std::equal(std::istreambuf_iterator<char>(chunkedFile), std::istreambuf_iterator<char>(),
+                                std::istreambuf_iterator<char>(singleFile), std::istreambuf_iterator<char>());
+    bool offlinePassed = identical && chunkedRows == singleRows && chunkedRows > 0;
+    std::cout << "Offline analysis: " << chunkedRows << " / " << singleRows << " rows, files "
+              << (identical ? "identical" : "DIFFER") << (offlinePassed ? "\n" : " FAIL\n");
+    passed = passed && offlinePassed;
+    chunkedFile.close();
+    singleFile.close();
+    std::remove("activations_chunked.bin");
+    std::remove("activations_single.bin");
+
+    // record 30 s of clicks, replay the trace into each stage and compare the replays with the recording
+    {
+        TraceRecorder recorder;
+        bool tracesOpened = recorder.open("clicks.trace", TraceAudio);
+        BeatNet recorded;
+        recorded.setup(sampleRate, blockSize);
+        recorded.setTraceRecorder(&recorder);
+        for (long long blockStart = 0; blockStart < 30 * static_cast<long long>(sampleRate); blockStart += blockSize) {
+            for (int n = 0; n < blockSize; ++n) {
+                long long phase = (blockStart + n) % clickPeriod;
+                block[n] = phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f;
+            }
+            recorded.process(block, output);
+        }
+        recorded.setTraceRecorder(nullptr);
+        recorder.close();
+
+        TraceReader trace;
+        tracesOpened = trace.open("clicks.trace") && tracesOpened;
+        bool replaysMatch = tracesOpened && trace.numBlocks() > 0;
+        const char* stageNames[] = { "framer", "model", "events" };
+        for (ReplayStage stage : { ReplayStage::Framer, ReplayStage::Model, ReplayStage::Events }) {
+            const std::string replayPath = std::string("clicks_") + stageNames[static_cast<int>(stage)] + ".trace";
+            TraceRecorder replayRecorder;
+            bool replayOpened = replayRecorder.open(replayPath, 0);
+            BeatNet replayed;
+            TraceReplayer replayer(replayed);
+            replayer.replay(trace, stage, false, &replayRecorder);
+            replayRecorder.close();
+
+            TraceReader replayTrace;
+            replayOpened = replayTrace.open(replayPath) && replayOpened;
+            std::cout << "Replay from " << stageNames[static_cast<int>(stage)] << ": " << replayer.hops() << " hops, "
+                      << replayer.events() << " events, " << 1e6 * replayer.processingSeconds() / std::max(1LL, replayer.hops())
+                      << " us/hop; ";
+            replaysMatch = compareTraces(trace, replayTrace, 1e-5f, std::cout) && replayOpened && replaysMatch;
+            std::remove(replayPath.c_str());
+        }
+        if (!replaysMatch)
+            std::cout << "Replay FAIL\n";
+        passed = passed && replaysMatch;
+        std::remove("clicks.trace");
+    }
+
+    // the shipped model carries the LSTM state, so a block of 16 hops goes through one [1, 16, 272] Run; its
+    // activations must match those of the same signal fed one hop per process call
+    {
+        const int batchHops = 16;
+        BeatNet hopByHop, batchedRun;
+        hopByHop.setup(SR_BEATNET, HOP_SIZE);
+        batchedRun.setup(SR_BEATNET, batchHops * HOP_SIZE);
+        std::vector<float> signal(static_cast<size_t>(20 * SR_BEATNET));
+        std::generate(signal.begin(), signal.end(), randomFloatGenerator);
+        std::vector<float> hopActivations, batchActivations, hopBlock(HOP_SIZE), batchBlock(batchHops * HOP_SIZE);
+        std::vector<BeatEvent> batchEvents;
+        batchEvents.reserve(16);
+        for (size_t start = 0; start + batchBlock.size() <= signal.size(); start += batchBlock.size()) {
+            batchBlock.assign(signal.begin() + start, signal.begin() + start + batchBlock.size());
+            batchedRun.process(batchBlock, output, batchEvents, batchActivations);
+            for (int hop = 0; hop < batchHops; ++hop) {
+                hopBlock.assign(batchBlock.begin() + hop * HOP_SIZE, batchBlock.begin() + (hop + 1) * HOP_SIZE);
+                hopByHop.process(hopBlock, output, batchEvents, hopActivations);
+            }
+        }
+        double maxDifference = 0.0;
+        for (size_t i = 0; i < std::min(hopActivations.size(), batchActivations.size()); ++i)
+            maxDifference = std::max(maxDifference, static_cast<double>(std::abs(hopActivations[i] - batchActivations[i])));
+        bool batchingPassed = batchedRun.isStatefulModel() && !batchActivations.empty()
+                              && hopActivations.size() == batchActivations.size() && maxDifference <= 1e-5;
+        std::cout << "Batched inference (" << (batchedRun.isStatefulModel() ? "stateful" : "stateless") << " model): "
+                  << batchActivations.size() / 3 << " hops in runs of " << batchHops << " vs. " << hopActivations.size() / 3
+                  << " one by one, max difference " << maxDifference << (batchingPassed ? "\n" : " FAIL\n");
+        passed = passed && batchingPassed;
+    }
+
+    // per-hop cost when a block completes T hops at once (one Run per block with the stateful model)
+    BeatNet batched;
+    for (int hops = 1; hops <= 16; ++hops) {
+        const int hopBlock = hops * HOP_SIZE;
+        batched.setup(SR_BEATNET, hopBlock);
+        std::vector<float> hopInput(hopBlock);
+        std::generate(hopInput.begin(), hopInput.end(), randomFloatGenerator);
+        const int blocks = 400 / hops + 1;
+        auto hopStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < blocks; ++i)
+            batched.process(hopInput, output);
+        double usPerHop = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - hopStart).count() / (blocks * hops);
+        std::cout << "T = " << hops << ": " << usPerHop << " us/hop\n";
+    }
+
+    // per-block cost of feeding multi-channel host buffers through the downmix and resampler
+    for (double hostRate : { 48000.0, 96000.0 }) {
+        for (int channels : { 1, 2, 8 }) {
+            Resampler resampler(hostRate, SR_BEATNET, blockSize);
+            std::vector<float> interleaved(static_cast<size_t>(blockSize) * channels);
+            std::generate(interleaved.begin(), interleaved.end(), randomFloatGenerator);
+            const int blocks = 2000;
+            auto blockStart = std::chrono::steady_clock::now();
+            for (int i = 0; i < blocks; ++i)
+                resampler.resampleInterleaved(interleaved.data(), channels, blockSize);
+            double usPerBlock = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - blockStart).count() / blocks;
+            std::cout << "Input stage " << hostRate << " Hz, " << channels << " channels: " << usPerBlock << " us/block\n";
+        }
+    }
+
+    // the planar and interleaved overloads must report the same activations for the same stereo signal (with two
+    // channels both downmixes halve exactly, so the results are bit-identical)
+    {
+        BeatNet interleavedTracker, planarTracker;
+        interleavedTracker.setup(sampleRate, blockSize);
+        planarTracker.setup(sampleRate, blockSize);
+        std::vector<float> left(blockSize), right(blockSize), stereo(2 * blockSize), stereoOutput(3);
+        std::vector<float> interleavedActivations, planarActivations;
+        std::vector<BeatEvent> stereoEvents;
+        stereoEvents.reserve(16);
+        const float* const channels[] = { left.data(), right.data() };
+        for (long long blockStart = 0; blockStart < 10 * static_cast<long long>(sampleRate); blockStart += blockSize) {
+            for (int n = 0; n < blockSize; ++n) {
+                long long phase = (blockStart + n) % clickPeriod;
+                left[n] = phase < 256 ? std::sin(phase * 0.3f) * std::exp(-phase / 64.0f) : 0.0f;
+                right[n] = (randomFloatGenerator() - 0.5f) * 0.1f;
+                stereo[2 * n] = left[n];
+                stereo[2 * n + 1] = right[n];
+            }
+            interleavedTracker.process(stereo.data(), 2, blockSize, stereoOutput, stereoEvents, interleavedActivations);
+            planarTracker.process(channels, 2, blockSize, stereoOutput, stereoEvents, planarActivations);
+        }
+        const bool layoutsMatch = !planarActivations.empty() && planarActivations == interleavedActivations;
+        std::cout << "Planar vs. interleaved stereo: " << planarActivations.size() / 3 << " / " << interleavedActivations.size() / 3
+                  << " hops, activations " << (layoutsMatch ? "identical\n" : "DIFFER FAIL\n");
+        passed = passed && layoutsMatch;
+    }
+
+    // the compile-time feature pipeline against the runtime-sized path it replaced (FramedSignalProcessor,
+    // FFTProcessor, FilterBankProcessor and the log/diff utilities) on a minute of noise, both on the builtin FFT:
+    // time per frame, and the features must be the same up to float rounding in the table construction
+    {
+        std::vector<float> noise(60 * SR_BEATNET);
+        std::generate(noise.begin(), noise.end(), randomFloatGenerator);
+        auto usPerFrame = [](long long frames, std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / std::max(1LL, frames);
+        };
+
+        FramedSignalProcessor runtimeFramer(FRAME_LENGTH, HOP_SIZE);
+        FFTProcessor runtimeFFT(FRAME_LENGTH, FFT_SIZE, FRAME_SIZE_POW2, FFTBackendType::Builtin);
+        FilterBankProcessor runtimeFilterbank(BANKS_PER_OCTAVE, FFT_SIZE, SR_BEATNET, FBANK_FMIN, FBANK_FMAX, true, true);
+        std::vector<float> runtimeFrame(FRAME_LENGTH), previousBands, runtimeFeatures;
+        runtimeFeatures.reserve(noise.size() / HOP_SIZE * FBANK_SIZE + FBANK_SIZE);
+        long long runtimeFrames = 0;
+        auto runtimeStart = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < noise.size();) {
+            bool frameReady = false;
+            offset += runtimeFramer.process(noise.data() + offset, static_cast<int>(noise.size() - offset), runtimeFrame, frameReady);
+            if (frameReady) {
+                std::vector<float> logBands = log_compress(runtimeFilterbank.apply(runtimeFFT.compute_fft(runtimeFrame)));
+                std::vector<float> difference = spectral_diff(logBands, previousBands);
+                runtimeFeatures.insert(runtimeFeatures.end(), logBands.begin(), logBands.end());
+                runtimeFeatures.insert(runtimeFeatures.end(), difference.begin(), difference.end());
+                runtimeFrames++;
+            }
+        }
+        double runtimeUs = usPerFrame(runtimeFrames, runtimeStart);
+
+        StaticFeaturePipeline<GithubGeometry> staticPipeline;
+        staticPipeline.configureFFT(FFTBackendType::Builtin, false);
+        StaticFeaturePipeline<GithubGeometry>::Features frameFeatures;
+        std::vector<float> staticFeatures;
+        staticFeatures.reserve(runtimeFeatures.capacity());
+        long long staticFrames = 0;
+        auto staticStart = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < noise.size();) {
+            bool frameReady = false;
+            offset += staticPipeline.process(noise.data() + offset, static_cast<int>(noise.size() - offset), frameReady);
+            if (frameReady) {
+                staticPipeline.computeFeatures(frameFeatures);
+                staticFeatures.insert(staticFeatures.end(), frameFeatures.begin(), frameFeatures.end());
+                staticFrames++;
+            }
+        }
+        double staticUs = usPerFrame(staticFrames, staticStart);
+
+        float maxFeatureError = 0.0f;
+        for (size_t i = 0; i < std::min(runtimeFeatures.size(), staticFeatures.size()); ++i)
+            maxFeatureError = std::max(maxFeatureError, std::abs(runtimeFeatures[i] - staticFeatures[i]));
+        bool featuresMatch = runtimeFrames == staticFrames && runtimeFeatures.size() == staticFeatures.size() && maxFeatureError <= 1e-5f;
+        std::cout << "Feature pipeline: runtime-sized " << runtimeUs << " us/frame, compile-time " << staticUs << " us/frame ("
+                  << runtimeFrames << " / " << staticFrames << " frames), max feature difference " << maxFeatureError
+                  << (featuresMatch ? "\n" : " FAIL\n");
+        passed = passed && featuresMatch;
+    }
+
+    // offline STFT throughput: frame by frame through the streaming path vs. the batched STFT
+    std::vector<float> track(60 * SR_BEATNET);
+    std::generate(track.begin(), track.end(), randomFloatGenerator);
+    auto framesPerSecond = [](long long frames, std::chrono::steady_clock::time_point start) {
+        return frames / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    StaticFramer<GithubGeometry> framer;
+    StaticFFT<GithubGeometry> frameFFT;
+    StaticFFT<GithubGeometry>::Spectrum spectrum;
+    long long frames = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < track.size();) {
+        bool frameReady = false;
+        offset += framer.process(track.data() + offset, static_cast<int>(track.size() - offset), frameReady);
+        if (frameReady) {
+            frameFFT.process(framer.frame(), spectrum);
+            frames++;
+        }
+    }
+    std::cout << "STFT per frame: " << framesPerSecond(frames, start) << " frames/s\n";
+
+    std::vector<BatchSTFT<GithubGeometry>::Spectrum> spectra;
+    for (unsigned threads = 1; threads <= std::max(4u, std::thread::hardware_concurrency()); threads *= 2) {
+        BatchSTFT<GithubGeometry> stft(static_cast<int>(threads));
+        start = std::chrono::steady_clock::now();
+        stft.process(track.data(), static_cast<long long>(track.size()), spectra);
+        std::cout << "STFT batched (" << stft.backendName() << ", " << threads << " threads): "
+                  << framesPerSecond(static_cast<long long>(spectra.size()), start) << " frames/s\n";
+    }
+
+    // memory and construction time of many streams, with a private copy of the tables per instance and with the
+    // tables shared through DSPTables: the streaming feature front end alone (its builtin FFT twiddles are the
+    // DSPTables user on that path) and whole BeatNet instances, ONNX session included
+    // (both rounds stay alive until the end, so that the second does not just reuse the pages the first freed)
+    std::vector<std::unique_ptr<StaticFeaturePipeline<GithubGeometry>>> pipelines;
+    std::vector<std::unique_ptr<BeatNet>> instances;
+    for (bool sharing : { false, true }) {
+        DSPTables::setSharingEnabled(sharing);
+        const int frontEnds = 64;
+        long long rssBefore = residentBytes();
+        auto constructStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < frontEnds; ++i) {
+            pipelines.push_back(std::make_unique<StaticFeaturePipeline<GithubGeometry>>());
+            pipelines.back()->configureFFT(FFTBackendType::Builtin, false);
+        }
+        double usPerFrontEnd = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - constructStart).count() / frontEnds;
+        std::cout << "Feature front ends, tables " << (sharing ? "shared" : "per instance") << ": "
+                  << (residentBytes() - rssBefore) / 1024.0 / frontEnds << " KiB and " << usPerFrontEnd << " us per instance, "
+                  << DSPTables::liveTables() << " tables (" << DSPTables::liveBytes() / 1024 << " KiB)\n";
+
+        const int streams = 8;
+        rssBefore = residentBytes();
+        constructStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < streams; ++i) {
+            instances.push_back(std::make_unique<BeatNet>());
+            instances.back()->configureFFT(FFTBackendType::Builtin);
+            instances.back()->setup(sampleRate, blockSize);
+        }
+        double msPerStream = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - constructStart).count() / streams;
+        std::cout << "BeatNet instances, tables " << (sharing ? "shared" : "per instance") << ": "
+                  << (residentBytes() - rssBefore) / 1024.0 / streams << " KiB and " << msPerStream << " ms per instance, "
+                  << DSPTables::liveTables() << " tables (" << DSPTables::liveBytes() / 1024 << " KiB)\n";
+    }
+    DSPTables::setSharingEnabled(true);
+
+    // many trackers served in turn by one thread, as a host with several tracks or beatnetd's workers do:
+    // throughput and the last level cache and TLB misses it causes, with regular and with huge page arenas
+    for (bool hugePages : { false, true }) {
+        Arena::setHugePages(hugePages);
+        const int instances = 16;
+        std::vector<std::unique_ptr<BeatNet>> trackers;
+        for (int i = 0; i < instances; ++i) {
+            trackers.push_back(std::make_unique<BeatNet>());
+            trackers.back()->setup(sampleRate, blockSize);
+        }
+        std::vector<float> roundRobinBlock(blockSize);
+        std::generate(roundRobinBlock.begin(), roundRobinBlock.end(), randomFloatGenerator);
+#ifdef __linux__
+        PerfCounter llcMisses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        PerfCounter tlbMisses(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#else
+        PerfCounter llcMisses(0, 0), tlbMisses(0, 0);
+#endif
+        const int rounds = 500;
+        llcMisses.start();
+        tlbMisses.start();
+        auto roundStart = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round)
+            for (std::unique_ptr<BeatNet>& instance : trackers)
+                instance->process(roundRobinBlock, output);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - roundStart).count();
+        long long llc = llcMisses.stop(), tlb = tlbMisses.stop();
+        const double blocks = static_cast<double>(rounds) * instances;
+        std::cout << instances << " trackers round robin, " << (hugePages ? "huge pages" : "regular pages") << ": "
+                  << blocks / seconds << " blocks/s, "
+                  << (llc < 0 ? std::string("n/a") : std::to_string(llc / blocks)) << " LLC misses and "
+                  << (tlb < 0 ? std::string("n/a") : std::to_string(tlb / blocks)) << " dTLB misses per block\n";
+    }
+    Arena::setHugePages(false);
+
+    // accuracy and speed on a synthetic 120 bpm 808 kick (30 s), the C++ side of the regression suite; real
+    // tracks go through --eval, e.g. test/test_data/808kick120bpm.mp3 converted to WAV. The first kick of every
+    // bar is accented so that the downbeats are audible; the run must meet the default --eval thresholds.
+    std::vector<float> kick(static_cast<size_t>(30 * sampleRate));
+    std::vector<double> kickBeats, kickDownbeats;
+    for (size_t n = 0; n < kick.size(); ++n) {
+        long long phase = static_cast<long long>(n) % clickPeriod;
+        double t = phase / sampleRate;
+        double gain = (static_cast<long long>(n) / clickPeriod) % 4 == 0 ? 0.8 : 0.5;
+        kick[n] = static_cast<float>(gain * std::exp(-t * 12.0) * std::sin(6.283185307179586 * (50.0 * t + 100.0 * (1.0 - std::exp(-t * 30.0)) / 30.0)));
+        if (phase == 0) {
+            kickBeats.push_back(n / sampleRate);
+            if (kickBeats.size() % 4 == 1) {
+                kickDownbeats.push_back(n / sampleRate);
+            }
+        }
+    }
+    Evaluation kickResult = evaluateTrack(kick, sampleRate, kickBeats, kickDownbeats);
+    printEvaluation("808 kick 120 bpm", kickResult);
+    bool kickPassed = meetsThresholds(kickResult, Thresholds());
+    if (!kickPassed)
+        std::cout << "808 kick FAIL\n";
+    passed = passed && kickPassed;
+
+    // fixed-lag decoding: accuracy against the lag, and the decoder's own cost against lag and beam width
+    // on the activations of the run above
+    for (double lag : { 0.0, 0.5, 1.0, 2.0 }) {
+        printEvaluation("808 kick 120 bpm, lag " + std::to_string(lag).substr(0, 3) + " s",
+                        evaluateTrack(kick, sampleRate, kickBeats, kickDownbeats, lag));
+    }
+    const long long kickFrames = static_cast<long long>(kickResult.activations.size() / 3);
+    for (int beam : { 256, 1024, 4096 }) {
+        for (double lag : { 0.0, 1.0, 2.0 }) {
+            FixedLagDecoder decoder;
+            decoder.configure(static_cast<int>(lag * SR_BEATNET / HOP_SIZE), beam);
+            double beatTime;
+            float activation;
+            bool downbeat;
+            auto decodeStart = std::chrono::steady_clock::now();
+            for (long long frame = 0; frame < kickFrames; ++frame)
+                decoder.process(&kickResult.activations[frame * 3], frame * HOP_SIZE / static_cast<double>(SR_BEATNET), beatTime, activation, downbeat);
+            double usPerFrame = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - decodeStart).count() / std::max(1LL, kickFrames);
+            std::cout << "Fixed-lag decoder, beam " << beam << ", lag " << lag << " s: " << usPerFrame << " us/frame\n";
+        }
+    }
+
+    // fixed-lag decoder on synthetic activations away from 120 bpm: beats (a downbeat every fourth) at 0.5 over a
+    // floor of 0.02, and spurious peaks as strong on 10% of the frames. The best path keeps moving beats within
+    // their observation region as the future comes in; a beat it moves back after its frame was decided must
+    // still be reported, so no gap between reported beats after 5 s may exceed 1.5 beat periods.
+    auto decodeSynthetic = [](double bpm, double lag, unsigned seed, double& beatF, double& longestGap) {
+        const double frameRate = SR_BEATNET / static_cast<double>(HOP_SIZE);
+        const long long numFrames = static_cast<long long>(60 * frameRate);
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::vector<float> synthetic(static_cast<size_t>(numFrames * 3));
+        std::vector<double> syntheticBeats, decodedBeats;
+        for (long long frame = 0; frame < numFrames; ++frame) {
+            long long beatIndex = std::llround(frame * bpm / 60.0 / frameRate);
+            float beat = 0.02f, downbeat = 0.01f;
+            if (std::llround(beatIndex * 60.0 / bpm * frameRate) == frame) {
+                syntheticBeats.push_back(frame / frameRate);
+                (beatIndex % 4 == 0 ? downbeat : beat) = 0.5f;
+            }
+            if (uniform(generator) < 0.1f)
+                beat = std::max(beat, 0.5f);
+            synthetic[frame * 3] = beat;
+            synthetic[frame * 3 + 1] = downbeat;
+            synthetic[frame * 3 + 2] = 1.0f - beat - downbeat;
+        }
+        FixedLagDecoder decoder;
+        decoder.configure(static_cast<int>(lag * frameRate), 256);
+        double beatTime;
+        float activation;
+        bool downbeat;
+        for (long long frame = 0; frame < numFrames; ++frame)
+            if (decoder.process(&synthetic[frame * 3], frame / frameRate, beatTime, activation, downbeat))
+                decodedBeats.push_back(beatTime);
+        while (decoder.flush(beatTime, activation, downbeat))
+            decodedBeats.push_back(beatTime);
+        std::vector<double> reported = BeatMetrics::trim(decodedBeats);
+        longestGap = 0.0;
+        for (size_t i = 1; i < reported.size(); ++i)
+            longestGap = std::max(longestGap, (reported[i] - reported[i - 1]) * bpm / 60.0);
+        beatF = BeatMetrics::fMeasure(BeatMetrics::trim(syntheticBeats), reported);
+    };
+    for (double bpm : { 75.0, 90.0 }) {
+        for (double lag : { 1.0, 2.0 }) {
+            double worstF = 1.0, longestGap = 0.0;
+            for (unsigned seed = 1; seed <= 5; ++seed) {
+                double beatF, gap;
+                decodeSynthetic(bpm, lag, seed, beatF, gap);
+                worstF = std::min(worstF, beatF);
+                longestGap = std::max(longestGap, gap);
+            }
+            bool decoderPassed = worstF >= 0.95 && longestGap <= 1.5;
+            std::cout << "Fixed-lag decoder, synthetic " << bpm << " bpm, lag " << lag << " s: lowest beat F " << worstF
+                      << ", longest gap " << longestGap << " beats" << (decoderPassed ? "\n" : " FAIL\n");
+            passed = passed && decoderPassed;
+        }
+    }
+    return passed ? 0 : 1;
 }
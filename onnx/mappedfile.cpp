@@ -0,0 +1,262 @@
+#include "mappedfile.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    size_t mappingGranularity()
+    {
+    #if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwAllocationGranularity;
+    #else
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    #endif
+    }
+}
+
+MappedFileWriter::~MappedFileWriter()
+{
+    close();
+}
+
+bool MappedFileWriter::open(const std::string& path, size_t window_bytes)
+{
+    close();
+    size_t granularity = mappingGranularity();
+    window_size = std::max<size_t>(1, (window_bytes + granularity - 1) / granularity) * granularity;
+    written = 0;
+    file_size = 0;
+
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    file = handle;
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool MappedFileWriter::isOpen() const
+{
+#if defined(_WIN32)
+    return file != nullptr;
+#else
+    return fd >= 0;
+#endif
+}
+
+bool MappedFileWriter::mapWindow(size_t offset)
+{
+    unmapWindow();
+    size_t start = offset - offset % window_size;
+    size_t end = start + window_size;
+
+#if defined(_WIN32)
+    // the mapping object fixes the file size, so it is recreated whenever the file grows
+    if (end > file_size || !mapping) {
+        if (mapping) CloseHandle(mapping);
+        file_size = std::max(file_size, end);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                     static_cast<DWORD>(static_cast<unsigned long long>(file_size) >> 32),
+                                     static_cast<DWORD>(file_size & 0xffffffffu), nullptr);
+        if (!mapping) {
+            std::cerr << "CreateFileMapping failed" << std::endl;
+            return false;
+        }
+    }
+    window = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE,
+                                              static_cast<DWORD>(static_cast<unsigned long long>(start) >> 32),
+                                              static_cast<DWORD>(start & 0xffffffffu), window_size));
+#else
+    // writing through a mapping past the end of the file faults, so grow it first
+    if (end > file_size) {
+        if (ftruncate(fd, static_cast<off_t>(end)) != 0) {
+            std::cerr << "Failed to grow the output file" << std::endl;
+            return false;
+        }
+        file_size = end;
+    }
+    void* address = mmap(nullptr, window_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(start));
+    window = address == MAP_FAILED ? nullptr : static_cast<char*>(address);
+#endif
+    if (!window) {
+        std::cerr << "Failed to map the output file" << std::endl;
+        return false;
+    }
+    window_offset = start;
+    return true;
+}
+
+void MappedFileWriter::unmapWindow()
+{
+    if (!window)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(window);
+#else
+    munmap(window, window_size);
+#endif
+    window = nullptr;
+}
+
+bool MappedFileWriter::writeAt(size_t offset, const void* data, size_t size)
+{
+    if (!isOpen())
+        return false;
+
+    const char* source = static_cast<const char*>(data);
+    while (size > 0) {
+        if (!window || offset < window_offset || offset >= window_offset + window_size) {
+            if (!mapWindow(offset))
+                return false;
+        }
+        size_t count = std::min(size, window_offset + window_size - offset);
+        std::memcpy(window + (offset - window_offset), source, count);
+        offset += count;
+        source += count;
+        size -= count;
+    }
+    written = std::max(written, offset);
+    return true;
+}
+
+bool MappedFileWriter::write(const void* data, size_t size)
+{
+    return writeAt(written, data, size);
+}
+
+size_t MappedFileWriter::size() const
+{
+    return written;
+}
+
+bool MappedFileWriter::close()
+{
+    if (!isOpen())
+        return false;
+
+    unmapWindow();
+    bool ok = true;
+#if defined(_WIN32)
+    if (mapping) CloseHandle(mapping);
+    mapping = nullptr;
+    LARGE_INTEGER length;
+    length.QuadPart = static_cast<LONGLONG>(written);
+    ok = SetFilePointerEx(file, length, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    CloseHandle(file);
+    file = nullptr;
+#else
+    ok = ftruncate(fd, static_cast<off_t>(written)) == 0;
+    ok = ::close(fd) == 0 && ok;
+    fd = -1;
+#endif
+    return ok;
+}
+
+MappedFileReader::~MappedFileReader()
+{
+    close();
+}
+
+bool MappedFileReader::open(const std::string& path)
+{
+    close();
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    file = handle;
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(handle, &length)) {
+        std::cerr << "Failed to read the size of " << path << std::endl;
+        close();
+        return false;
+    }
+    file_size = static_cast<size_t>(length.QuadPart);
+    if (file_size > 0) {
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        std::cerr << "Failed to read the size of " << path << std::endl;
+        close();
+        return false;
+    }
+    file_size = static_cast<size_t>(info.st_size);
+    if (file_size > 0) {
+        void* address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        view = address == MAP_FAILED ? nullptr : static_cast<const char*>(address);
+    }
+#endif
+    if (file_size > 0 && !view) {
+        std::cerr << "Failed to map " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFileReader::isOpen() const
+{
+#if defined(_WIN32)
+    return file != nullptr;
+#else
+    return fd >= 0;
+#endif
+}
+
+void MappedFileReader::close()
+{
+#if defined(_WIN32)
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (view) munmap(const_cast<char*>(view), file_size);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    view = nullptr;
+    file_size = 0;
+}
+
+const char* MappedFileReader::data() const
+{
+    return view;
+}
+
+size_t MappedFileReader::size() const
+{
+    return file_size;
+}
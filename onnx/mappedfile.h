@@ -0,0 +1,73 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Writes a file through a memory-mapped window that slides along it, so that the mapping (and the dirty
+// pages it can pin) stays bounded by the window size however large the file grows.
+class MappedFileWriter {
+public:
+    MappedFileWriter() = default;
+    ~MappedFileWriter();
+    MappedFileWriter(const MappedFileWriter&) = delete;
+    MappedFileWriter& operator=(const MappedFileWriter&) = delete;
+
+    // creates or truncates the file, window_bytes is rounded up to the mapping granularity
+    bool open(const std::string& path, size_t window_bytes);
+    bool isOpen() const;
+
+    // appends at the end of what has been written so far
+    bool write(const void* data, size_t size);
+    // overwrites bytes at any offset, e.g. a header once the totals are known
+    bool writeAt(size_t offset, const void* data, size_t size);
+    size_t size() const;
+
+    // unmaps and cuts the file to the bytes written
+    bool close();
+
+private:
+    bool mapWindow(size_t offset);
+    void unmapWindow();
+
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    char* window = nullptr;
+    size_t window_offset = 0;
+    size_t window_size = 0;
+    size_t file_size = 0;
+    size_t written = 0;
+};
+
+// Maps a whole file read-only.
+class MappedFileReader {
+public:
+    MappedFileReader() = default;
+    ~MappedFileReader();
+    MappedFileReader(const MappedFileReader&) = delete;
+    MappedFileReader& operator=(const MappedFileReader&) = delete;
+
+    bool open(const std::string& path);
+    bool isOpen() const;
+    void close();
+
+    // page aligned, nullptr for an empty or closed file
+    const char* data() const;
+    size_t size() const;
+
+private:
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    const char* view = nullptr;
+    size_t file_size = 0;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "offlineanalyzer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+OfflineAnalyzer::OfflineAnalyzer(BeatNet& tracker, double sampleRate, long chunkFrames):
+    tracker(tracker),
+    sample_rate(sampleRate),
+    chunk_frames(std::max(1L, chunkFrames)),
+    output(3)
+{
+    // a chunk completes at most this many hops, plus a partial batch waiting from the previous one
+    long hops_per_chunk = static_cast<long>(std::ceil(chunk_frames * SR_BEATNET / sample_rate / HOP_SIZE)) + 1;
+    chunk.reserve(chunk_frames);
+    activations.reserve(3 * (hops_per_chunk + MAX_BATCH_HOPS));
+    events.reserve(64);
+}
+
+bool OfflineAnalyzer::writeActivations()
+{
+    bool ok = writer.write(activations.data(), activations.size() * sizeof(float));
+    activations.clear();
+    return ok;
+}
+
+long long OfflineAnalyzer::analyze(const Reader& reader, const std::string& outputPath)
+{
+    if (!tracker.setup(sample_rate, static_cast<int>(chunk_frames)))
+        return -1;
+    tracker.setFixedBatches(true);
+    tracker.setLoadShedding(false);
+
+    ActivationFileHeader header {};
+    std::memcpy(header.magic, "BNACTIV", 8);
+    header.version = FILE_VERSION;
+    header.num_classes = 3;
+    header.frame_rate = static_cast<double>(SR_BEATNET) / HOP_SIZE;
+
+    // a few chunks worth of activations per window
+    size_t window = activations.capacity() * sizeof(float) * 4;
+    bool ok = writer.open(outputPath, window) && writer.write(&header, sizeof(header));
+
+    chunk.resize(chunk_frames);
+    while (ok) {
+        long frames = reader(chunk.data(), chunk_frames);
+        if (frames <= 0)
+            break;
+        chunk.resize(std::min(frames, chunk_frames));   // within the reserved capacity
+        tracker.process(chunk, output, events, activations);
+        ok = writeActivations();
+        chunk.resize(chunk_frames);
+    }
+    if (ok) {
+        tracker.finish(events, activations);
+        ok = writeActivations();
+    }
+    tracker.setFixedBatches(false);
+
+    header.num_frames = (writer.size() - sizeof(header)) / (3 * sizeof(float));
+    ok = ok && writer.writeAt(0, &header, sizeof(header));
+    ok = writer.close() && ok;
+    if (!ok) {
+        std::cerr << "Failed to write activations to " << outputPath << std::endl;
+        return -1;
+    }
+    return static_cast<long long>(header.num_frames);
+}
@@ -0,0 +1,52 @@
+#ifndef OFFLINE_ANALYZER_H
+#define OFFLINE_ANALYZER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "BeatNet.h"
+#include "mappedfile.h"
+
+// Header of the activation files written by OfflineAnalyzer, followed by num_frames rows of
+// num_classes float32 activations (beat, downbeat, non-beat) in native byte order.
+struct ActivationFileHeader {
+    char magic[8];          // "BNACTIV" and a terminating zero
+    uint32_t version;
+    uint32_t num_classes;
+    double frame_rate;      // rows per second of audio
+    uint64_t num_frames;
+};
+
+// Runs recordings of any length through BeatNet chunk by chunk and writes the activations to a memory-mapped
+// file as they come out. Framer overlap, difference history, LSTM state and resampler state simply carry over
+// from one chunk to the next inside the tracker, and with fixed batches the model sees the same hops in the
+// same Run calls whatever the chunk size, so the file does not depend on it. Memory use is O(chunk).
+class OfflineAnalyzer {
+public:
+    // fills buffer with up to max_frames mono samples, returns how many, 0 at the end of the recording
+    using Reader = std::function<long(float* buffer, long max_frames)>;
+
+    // tracker should be fresh, its stream state becomes part of the analysis
+    OfflineAnalyzer(BeatNet& tracker, double sampleRate, long chunkFrames = 1 << 16);
+
+    // returns the number of activation rows written, -1 if the file could not be written
+    long long analyze(const Reader& reader, const std::string& outputPath);
+
+    static constexpr uint32_t FILE_VERSION = 1;
+
+private:
+    BeatNet& tracker;
+    double sample_rate;
+    long chunk_frames;
+
+    std::vector<float> chunk;
+    std::vector<float> output;
+    std::vector<BeatEvent> events;
+    std::vector<float> activations;
+    MappedFileWriter writer;
+
+    bool writeActivations();
+};
+
+#endif
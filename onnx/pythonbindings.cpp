@@ -0,0 +1,178 @@
+// Python module over the C++ pipeline: preprocessing, inference and beat events without madmom or torch.
+//
+//     import beatnet_cpp
+//     tracker = beatnet_cpp.BeatNet()
+//     tracker.setup(44100, 1024)
+//     activations, events = tracker.process(block)   # float32 [frames] or [frames, channels]
+//
+// Input blocks are read in place (they must be C-contiguous float32, nothing is converted) and the GIL is
+// released while the pipeline runs. The arrays returned own their memory: the buffers the pipeline wrote are
+// handed over to them without a copy, and the tracker starts the next call on new ones.
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+#include <stdexcept>
+#include "BeatNet.h"
+
+namespace py = pybind11;
+
+namespace {
+
+    using InputArray = py::array_t<float, py::array::c_style>;
+
+    class PyBeatNet {
+    public:
+        PyBeatNet(const std::string& model_path, int intra_op_threads)
+            : tracker(model_path, "BeatNet", ORT_LOGGING_LEVEL_WARNING, intra_op_threads), output(3)
+        {
+            events.reserve(64);
+        }
+
+        bool setup(double sample_rate, int block_size)
+        {
+            this->sample_rate = sample_rate;
+            this->block_size = block_size;
+            return tracker.setup(sample_rate, block_size);
+        }
+
+        // one block of the stream, events are positioned relative to its first frame
+        py::tuple process(const InputArray& block)
+        {
+            int num_frames, num_channels;
+            shape(block, num_frames, num_channels);
+            activations.clear();
+            {
+                py::gil_scoped_release release;
+                tracker.process(block.data(), num_channels, num_frames, output, events, activations);
+                storeEvents(0);
+            }
+            return results();
+        }
+
+        // A whole recording, chunk by chunk with fixed batches, so the result does not depend on chunk_frames.
+        // Meant for a fresh tracker; event positions are in frames from the start of the recording.
+        py::tuple analyze(const InputArray& audio, double sample_rate, int chunk_frames)
+        {
+            int num_frames, num_channels;
+            shape(audio, num_frames, num_channels);
+            if (chunk_frames <= 0)
+                throw std::invalid_argument("chunk_frames must be positive");
+
+            activations.clear();
+            event_rows.clear();
+            {
+                py::gil_scoped_release release;
+                setup(sample_rate, chunk_frames);
+                tracker.setFixedBatches(true);
+                tracker.setLoadShedding(false);
+                activations.reserve(3 * (static_cast<size_t>(static_cast<double>(num_frames) * SR_BEATNET / sample_rate / HOP_SIZE) + MAX_BATCH_HOPS + 2));
+                long start = 0;
+                for (long next = 0; next < num_frames; next += chunk_frames) {
+                    start = next;
+                    int frames = static_cast<int>(std::min<long>(chunk_frames, num_frames - start));
+                    tracker.process(audio.data() + start * num_channels, num_channels, frames, output, events, activations);
+                    appendEvents(start);
+                }
+                // finish() positions its events relative to the last chunk
+                tracker.finish(events, activations);
+                appendEvents(start);
+                tracker.setFixedBatches(false);
+            }
+            return results();
+        }
+
+        BeatNet tracker;
+        double sample_rate = 0.0;
+        int block_size = 0;
+
+    private:
+        static void shape(const InputArray& block, int& num_frames, int& num_channels)
+        {
+            if (block.ndim() == 1) {
+                num_frames = static_cast<int>(block.shape(0));
+                num_channels = 1;
+            } else if (block.ndim() == 2) {
+                num_frames = static_cast<int>(block.shape(0));
+                num_channels = static_cast<int>(block.shape(1));
+            } else {
+                throw std::invalid_argument("expected a float32 array of shape [frames] or [frames, channels]");
+            }
+            if (num_channels < 1)
+                throw std::invalid_argument("at least one channel is required");
+        }
+
+        void storeEvents(long offset)
+        {
+            event_rows.clear();
+            appendEvents(offset);
+        }
+
+        void appendEvents(long offset)
+        {
+            for (const BeatEvent& event : events) {
+                event_rows.push_back(static_cast<double>(offset + event.sample));
+                event_rows.push_back(event.activation);
+                event_rows.push_back(event.downbeat ? 1.0 : 0.0);
+            }
+        }
+
+        // Moves the rows out of `buffer` into a [rows, 3] array that frees them with the last reference to it,
+        // so an array kept from an earlier call never points into memory the tracker reallocates. `buffer` gets
+        // the same capacity again, so the next call usually does not grow it while the pipeline runs.
+        template<typename T>
+        static py::array handOver(std::vector<T>& buffer)
+        {
+            auto* rows = new std::vector<T>(std::move(buffer));
+            py::capsule owner(rows, [](void* pointer) { delete static_cast<std::vector<T>*>(pointer); });
+            buffer = std::vector<T>();
+            buffer.reserve(rows->capacity());
+            return py::array_t<T>({ static_cast<py::ssize_t>(rows->size() / 3), py::ssize_t(3) },
+                                  { 3 * sizeof(T), sizeof(T) }, rows->data(), owner);
+        }
+
+        // activations [hops, 3] and events [events, 3]: frame, activation, downbeat (0 or 1)
+        py::tuple results()
+        {
+            py::array activation_rows = handOver(activations);
+            return py::make_tuple(activation_rows, handOver(event_rows));
+        }
+
+        std::vector<float> output;
+        std::vector<BeatEvent> events;
+        std::vector<float> activations;
+        std::vector<double> event_rows;
+    };
+}
+
+PYBIND11_MODULE(beatnet_cpp, m)
+{
+    m.doc() = "BeatNet beat and downbeat tracking, C++ pipeline";
+
+    py::class_<PyBeatNet>(m, "BeatNet")
+        .def(py::init<const std::string&, int>(), py::arg("model_path") = "", py::arg("intra_op_threads") = 1)
+        .def("setup", &PyBeatNet::setup, py::arg("sample_rate"), py::arg("block_size"),
+             "Prepares the tracker for blocks of up to block_size frames at sample_rate.")
+        .def("process", &PyBeatNet::process, py::arg("block").noconvert(),
+             "Processes one float32 block of shape [frames] or [frames, channels] in place. Returns (activations [hops, 3], "
+             "events [n, 3] as frame, activation, downbeat), arrays of their own.")
+        .def("analyze", &PyBeatNet::analyze, py::arg("audio").noconvert(), py::arg("sample_rate"), py::arg("chunk_frames") = 1 << 16,
+             "Analyses a whole float32 recording. Returns (activations [frames, 3], events [n, 3]) like process().")
+        .def("set_energy_gate", [](PyBeatNet& self, bool enabled, float threshold_db, float flux_db) {
+                 self.tracker.setEnergyGate(enabled, threshold_db, flux_db);
+             }, py::arg("enabled"), py::arg("threshold_db") = -60.0f, py::arg("flux_db") = 6.0f)
+        .def("set_fixed_lag_decoding", [](PyBeatNet& self, bool enabled, double lag_seconds, int beam_width) {
+                 self.tracker.setFixedLagDecoding(enabled, lag_seconds, beam_width);
+             }, py::arg("enabled"), py::arg("lag_seconds") = 1.0, py::arg("beam_width") = 1024,
+             "Decides beats with the fixed-lag bar pointer decoder, reported lag_seconds late.")
+        .def("set_load_shedding", [](PyBeatNet& self, bool enabled, double budget) {
+                 self.tracker.setLoadShedding(enabled, budget);
+             }, py::arg("enabled"), py::arg("budget") = 0.5)
+        .def_property_readonly("latency", [](const PyBeatNet& self) { return self.tracker.getLatency(); },
+                               "Delay of the whole chain in host frames.")
+        .def_property_readonly("tempo", [](const PyBeatNet& self) { return self.tracker.getStableTempo(); })
+        .def_property_readonly("tempo_confidence", [](const PyBeatNet& self) { return self.tracker.getTempoConfidence(); })
+        .def_property_readonly("fft_backend", [](const PyBeatNet& self) { return std::string(self.tracker.getFFTBackendName()); });
+
+    m.attr("FRAME_RATE") = static_cast<double>(SR_BEATNET) / HOP_SIZE;
+}
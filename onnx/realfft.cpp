@@ -0,0 +1,59 @@
+#include "realfft.h"
+#include <algorithm>
+#include <iostream>
+
+RealFFT::RealFFT(int size, FFTBackendType type)
+{
+    configure(size, type);
+}
+
+void RealFFT::configure(int size, FFTBackendType type)
+{
+    FFTBackendType requested = type == FFTBackendType::Auto ? FFTAutoTuner::choose(size) : type;
+    backend = FFTBackend::create(requested, size);
+    if (!backend) {
+        std::cerr << "FFT backend " << FFTBackend::name(requested) << " is not available for size " << size << ", falling back" << std::endl;
+        std::vector<FFTBackendType> candidates = FFTBackend::available(size);
+        if (!candidates.empty())
+            backend = FFTBackend::create(candidates.front(), size);
+    }
+    if (!backend) {
+        std::cerr << "No FFT backend can run a transform of size " << size << std::endl;
+        return;
+    }
+    std::fill(backend->input(), backend->input() + size, 0.0f);
+}
+
+int RealFFT::size() const
+{
+    return backend ? backend->size() : 0;
+}
+
+float* RealFFT::input()
+{
+    return backend ? backend->input() : nullptr;
+}
+
+void RealFFT::magnitudes(float* output, int num_bins)
+{
+    if (!backend) {
+        std::fill(output, output + num_bins, 0.0f);
+        return;
+    }
+    backend->magnitudes(output, num_bins);
+}
+
+FFTBackendType RealFFT::backendType() const
+{
+    return backend ? backend->type() : FFTBackendType::Auto;
+}
+
+const char* RealFFT::backendName() const
+{
+    return backend ? FFTBackend::name(backend->type()) : "none";
+}
+
+double RealFFT::nsPerFrame() const
+{
+    return backend ? FFTAutoTuner::measure(backend->type(), backend->size()) : 0.0;
+}
@@ -0,0 +1,34 @@
+#ifndef REAL_FFT_H
+#define REAL_FFT_H
+
+#include <memory>
+#include "fftbackend.h"
+
+// Forward real-to-complex transform of a fixed size, on top of one of the FFT backends.
+// The caller fills input() and reads back the magnitude spectrum.
+class RealFFT {
+public:
+    // Auto picks the backend through FFTAutoTuner
+    explicit RealFFT(int size, FFTBackendType type = FFTBackendType::Auto);
+
+    // recreates the transform, input() is zeroed. Allocates, not real time safe.
+    void configure(int size, FFTBackendType type);
+
+    int size() const;
+
+    // size() samples, overwritten by the caller before every transform
+    float* input();
+
+    // runs the transform and writes the magnitude of the first num_bins bins
+    void magnitudes(float* output, int num_bins);
+
+    FFTBackendType backendType() const;
+    const char* backendName() const;
+    // measured time of one transform of this size with this backend, in nanoseconds
+    double nsPerFrame() const;
+
+private:
+    std::unique_ptr<FFTBackend> backend;
+};
+
+#endif
@@ -0,0 +1,43 @@
+"""Writes the activations of the PyTorch BeatNet for an audio file, as reference for the C++ evaluation.
+
+The file has the layout of the activation files written by the C++ OfflineAnalyzer (offlineanalyzer.h):
+an ActivationFileHeader followed by one row of float32 (beat, downbeat, non-beat) per frame.
+
+    python referenceActivations.py ../test/test_data/808kick120bpm.mp3 808kick120bpm.activations
+"""
+import os
+import struct
+import sys
+
+import numpy as np
+import torch
+
+sys.path.insert(0, os.path.abspath("../src"))
+from BeatNet.BeatNet import BeatNet
+
+FILE_VERSION = 1
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(1)
+    audio_path, output_path = sys.argv[1], sys.argv[2]
+
+    estimator = BeatNet(1, mode='offline', inference_model='DBN', plot=[], thread=False)
+    with torch.no_grad():
+        import librosa
+        audio, _ = librosa.load(audio_path, sr=estimator.sample_rate)
+        feats = torch.from_numpy(estimator.proc.process_audio(audio).T).unsqueeze(0)
+        preds = estimator.model.final_pred(estimator.model(feats)[0])
+        rows = np.ascontiguousarray(preds.cpu().numpy().T, dtype=np.float32)  # [frames, 3]
+
+    frame_rate = estimator.sample_rate / estimator.log_spec_hop_length
+    with open(output_path, "wb") as f:
+        f.write(struct.pack("=8sIIdQ", b"BNACTIV\0", FILE_VERSION, rows.shape[1], frame_rate, rows.shape[0]))
+        f.write(rows.tobytes())
+    print(f"{rows.shape[0]} frames written to {output_path}")
+
+
+if __name__ == "__main__":
+    main()
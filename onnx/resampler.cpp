@@ -1,6 +1,58 @@
 #include "resampler.h"
+#include "rtlog.h"
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+
+namespace {
+
+    // Channel counts known at compile time let the compiler unroll the inner loop and vectorise across frames
+    template<int Channels>
+    void downmixInterleaved(const float* input, long num_frames, float* output)
+    {
+        constexpr float gain = 1.0f / Channels;
+        for (long i = 0; i < num_frames; ++i) {
+            const float* frame = input + i * Channels;
+            float sum = 0.0f;
+            for (int c = 0; c < Channels; ++c)
+                sum += frame[c];
+            output[i] = sum * gain;
+        }
+    }
+
+    void downmixInterleaved(const float* input, int num_channels, long num_frames, float* output)
+    {
+        switch (num_channels) {
+            case 2: downmixInterleaved<2>(input, num_frames, output); return;
+            case 4: downmixInterleaved<4>(input, num_frames, output); return;
+            case 6: downmixInterleaved<6>(input, num_frames, output); return;
+            case 8: downmixInterleaved<8>(input, num_frames, output); return;
+            default: break;
+        }
+        const float gain = 1.0f / num_channels;
+        for (long i = 0; i < num_frames; ++i) {
+            const float* frame = input + i * num_channels;
+            float sum = 0.0f;
+            for (int c = 0; c < num_channels; ++c)
+                sum += frame[c];
+            output[i] = sum * gain;
+        }
+    }
+
+    // channel by channel, every pass is a contiguous multiply-add the compiler vectorises
+    void downmixPlanar(const float* const* input, int num_channels, long offset, long num_frames, float* output)
+    {
+        const float gain = 1.0f / num_channels;
+        const float* first = input[0] + offset;
+        for (long i = 0; i < num_frames; ++i)
+            output[i] = first[i] * gain;
+        for (int c = 1; c < num_channels; ++c) {
+            const float* channel = input[c] + offset;
+            for (long i = 0; i < num_frames; ++i)
+                output[i] += channel[i] * gain;
+        }
+    }
+}
 
 bool Resampler::loadLibsamplerate(){
     std::string libname;
@@ -18,93 +70,189 @@ bool Resampler::loadLibsamplerate(){
         return false;
     }
 
-    callback_new = reinterpret_cast<src_callback_new_t>(PluginUtils::getSymbol(samplerate_handle, "src_callback_new" ));
-    callback_read = reinterpret_cast<src_callback_read_t>(PluginUtils::getSymbol(samplerate_handle, "src_callback_read"));
+    src_new = reinterpret_cast<src_new_t>(PluginUtils::getSymbol(samplerate_handle, "src_new"));
+    src_process = reinterpret_cast<src_process_t>(PluginUtils::getSymbol(samplerate_handle, "src_process"));
     strerror = reinterpret_cast<src_strerror_t>(PluginUtils::getSymbol(samplerate_handle, "src_strerror"));
-    if (!callback_new || !callback_read || !strerror) {
+    src_delete = reinterpret_cast<src_delete_t>(PluginUtils::getSymbol(samplerate_handle, "src_delete"));
+    if (!src_new || !src_process || !strerror || !src_delete) {
         std::cerr << "One or more symbols failed to load.\n";
         return false;
     }
     return true;
 
 }
-Resampler::Resampler(){
-    bool libsamplerateLoaded = loadLibsamplerate();
-    if (!libsamplerateLoaded)
-    {
-        std::cerr << "Could not load libsamplerate"<<std::endl;
-    }
-}
 
-Resampler::Resampler(double input_sr, double output_sr, long bufferSize ): 
-    ratio(output_sr / input_sr), 
+Resampler::Resampler(double input_sr, double output_sr, long bufferSize ):
+    state(nullptr),
+    error(0),
+    ratio(output_sr / input_sr),
     buffer_size(bufferSize),
-    output_frame_count(static_cast<long>(static_cast<float>(buffer_size) * ratio + 0.5)),// round to nearest
-    silence(output_frame_count, 0.0f),
-    output_buffer(output_frame_count, 0.0f)
+    max_output_frames(static_cast<long>(std::ceil(bufferSize * ratio)) + 1),
+    latency(0.0)
 {
-    error = 0;
-    output_frame_count = static_cast<long>(static_cast<float>(buffer_size) * ratio + 0.5); // round to nearest
-    cb_data.total_frames = static_cast<long>(buffer_size);
+    // resample() reports errors through the real-time log, start it here rather than on the audio thread
+    RTLog::start();
+
+    // libsamplerate only supports conversion ratios up to 256 in either direction
+    if (!(ratio >= 1.0 / 256.0 && ratio <= 256.0) || buffer_size <= 0) {
+        std::cerr << "Unsupported resampling ratio " << ratio << std::endl;
+        return;
+    }
+    output_buffer.reserve(max_output_frames);
+    downmix_buffer.resize(buffer_size);
+    pending_input.reserve(2 * buffer_size);
 
     bool libsamplerateLoaded = loadLibsamplerate();
     if (!libsamplerateLoaded)
     {
         std::cerr << "Could not load libsamplerate"<<std::endl;
+        return;
     }
 
+    state = src_new(SRC_SINC_FASTEST, 1, &error);
+    if (!state) {
+        std::cerr << "libsamplerate error: " << strerror(error) << std::endl;
+        return;
+    }
+    measureLatency();
 }
 
 Resampler::~Resampler()
 {
+    if (state)
+    {
+        src_delete(state);
+    }
     if (samplerate_handle)
     {
         PluginUtils::unloadDynamicLibrary(samplerate_handle);
     }
 }
 
-void Resampler::setup(double input_sr, double output_sr, long bufferSize)
+void Resampler::measureLatency()
 {
-    if (bufferSize>0){
-        ratio = output_sr / input_sr; 
-        buffer_size = bufferSize;
-        output_frame_count = static_cast<long>(static_cast<float>(buffer_size) * ratio + 0.5) ; // round to nearest
-        silence.resize(output_frame_count, 0.0f);
-        output_buffer.resize(output_frame_count, 0.0f);
-        error = 0;
-        output_frame_count = static_cast<long>(static_cast<float>(buffer_size) * ratio + 0.5); // round to nearest
-        cb_data.total_frames = static_cast<long>(buffer_size);
-    }
-}
+    // push an impulse through a scratch converter and see where it comes out
+    const long probe_frames = 4096;
+    const long impulse_pos = probe_frames / 4;
+    std::vector<float> probe(probe_frames, 0.0f);
+    probe[impulse_pos] = 1.0f;
+    std::vector<float> probe_output(static_cast<size_t>(std::ceil(probe_frames * ratio)) + 1, 0.0f);
 
-long Resampler::callback(void* data, float** out_data) {
-    
-    CallbackData* cb = static_cast<CallbackData*>(data);
+    int probe_error = 0;
+    SRC_STATE* probe_state = src_new(SRC_SINC_FASTEST, 1, &probe_error);
+    if (!probe_state)
+        return;
 
-    if (cb->position >= cb->total_frames)
-        return 0;
+    SRC_DATA data {};
+    data.data_in = probe.data();
+    data.data_out = probe_output.data();
+    data.input_frames = probe_frames;
+    data.output_frames = static_cast<long>(probe_output.size());
+    data.end_of_input = 1;
+    data.src_ratio = ratio;
+    probe_error = src_process(probe_state, &data);
+    src_delete(probe_state);
 
-    long remaining = cb->total_frames - cb->position;
+    if (probe_error || data.output_frames_gen <= 0)
+        return;
 
-    *out_data = const_cast<float*>(cb->input + cb->position);
-    cb->position += remaining;
+    long peak = 0;
+    for (long i = 1; i < data.output_frames_gen; ++i)
+        if (std::abs(probe_output[i]) > std::abs(probe_output[peak]))
+            peak = i;
+    latency = std::max(0.0, static_cast<double>(peak) - impulse_pos * ratio);
+}
+
+long Resampler::convert(const float* input, long num_frames, long& generated) {
+    // src_process stops when its output is full, call it again until the input is used up
+    long used = 0;
+    while (used < num_frames && generated < max_output_frames) {
+        SRC_DATA data {};
+        data.data_in = input + used;
+        data.data_out = output_buffer.data() + generated;
+        data.input_frames = num_frames - used;
+        data.output_frames = max_output_frames - generated;
+        data.end_of_input = 0;
+        data.src_ratio = ratio;
 
-    return remaining;
+        error = src_process(state, &data);
+        if (error) {
+            RTLOG_ERROR("libsamplerate error: %s", strerror(error));
+            break;
+        }
+        used += data.input_frames_used;
+        generated += data.output_frames_gen;
+        if (data.input_frames_used == 0 && data.output_frames_gen == 0) {
+            break;
+        }
+    }
+    return used;
 }
 
-std::vector<float> Resampler::resample(const std::vector<float>& input) {
+const std::vector<float>& Resampler::resample(const float* input, long num_frames) {
 
-    if (input.empty()) {
-        return silence;
+    // the buffers were reserved upfront, resizing within the capacity does not allocate
+    output_buffer.resize(max_output_frames);
+    num_frames = std::min(num_frames, buffer_size);
+    error = 0;
+    if (!state) {
+        output_buffer.clear();
+        return output_buffer;
     }
 
-    cb_data.input = input.data();
-    cb_data.position = 0;
-    
-    SRC_STATE* state_ = callback_new(callback, SRC_SINC_FASTEST, 1, &error, &cb_data);
-    if (!state_) {
-        std::cerr << "libsamplerate error: " << strerror(error) << std::endl;
+    // input left over from the last call goes first, whatever does not fit now waits for the next one
+    long generated = 0;
+    long used = 0;
+    if (!pending_input.empty()) {
+        long pending_used = convert(pending_input.data(), static_cast<long>(pending_input.size()), generated);
+        pending_input.erase(pending_input.begin(), pending_input.begin() + pending_used);
+    }
+    if (pending_input.empty() && !error) {
+        used = convert(input, num_frames, generated);
     }
-    long frames_written = callback_read(state_, ratio, output_frame_count, output_buffer.data());
+    pending_input.insert(pending_input.end(), input + used, input + num_frames);
+
+    if (error) {
+        pending_input.clear();
+        generated = 0;
+    }
+    output_buffer.resize(generated);
     return output_buffer;
 }
+
+const std::vector<float>& Resampler::resample(const std::vector<float>& input) {
+    return resample(input.data(), static_cast<long>(input.size()));
+}
+
+const std::vector<float>& Resampler::resampleInterleaved(const float* input, int num_channels, long num_frames) {
+    if (num_channels <= 1) {
+        return resample(input, num_frames);
+    }
+    num_frames = std::min(num_frames, static_cast<long>(downmix_buffer.size()));
+    downmixInterleaved(input, num_channels, num_frames, downmix_buffer.data());
+    return resample(downmix_buffer.data(), num_frames);
+}
+
+const std::vector<float>& Resampler::resamplePlanar(const float* const* input, int num_channels, long offset, long num_frames) {
+    if (num_channels <= 1) {
+        return resample(input[0] + offset, num_frames);
+    }
+    num_frames = std::min(num_frames, static_cast<long>(downmix_buffer.size()));
+    downmixPlanar(input, num_channels, offset, num_frames, downmix_buffer.data());
+    return resample(downmix_buffer.data(), num_frames);
+}
+
+bool Resampler::isValid() const
+{
+    return state != nullptr;
+}
+
+long Resampler::getBufferSize() const
+{
+    return buffer_size;
+}
+
+double Resampler::getLatency() const
+{
+    return latency;
+}
@@ -6,57 +6,64 @@
 #include "dynamic_link.h"
 
 // type aliases
-using src_callback_t = long (*)(void* cb_data, float** data);
-using src_callback_new_t  = SRC_STATE* (*)(src_callback_t, int, int, int*, void*);
+using src_new_t           = SRC_STATE* (*)(int, int, int*);
+using src_process_t       = int (*)(SRC_STATE*, SRC_DATA*);
 using src_strerror_t      = const char* (*)(int);
-using src_callback_read_t = long (*)(SRC_STATE*, double, long, float*);
+using src_delete_t        = SRC_STATE* (*)(SRC_STATE*);
 
+// Streaming sample rate converter. All allocations happen in the constructor, so that a new
+// instance can be prepared off the audio thread and swapped in when the host configuration changes.
 class Resampler {
 public:
     Resampler(double input_sr, double output_sr, long bufferSize);
-    Resampler();
-    
+
     ~Resampler();
     Resampler(const Resampler&) = delete;     // copy constructor
     Resampler& operator=(const Resampler&) = delete;     // copy assignment
     Resampler(Resampler&&) = delete; //move constructor
     Resampler& operator=(Resampler&&) = delete; //move assignment
 
+    // Converts up to bufferSize input samples. The returned buffer is owned by the resampler
+    // and stays valid until the next call. Input the converter cannot take in this call is kept
+    // and converted first in the next one, so no samples are dropped.
+    const std::vector<float>& resample(const float* input, long num_frames);
+    const std::vector<float>& resample(const std::vector<float>& input);
 
-    void setup(double input_sr, double output_sr, long bufferSize);
-
-    std::vector<float> resample(const std::vector<float>& input);
+    // Multi-channel host buffers are downmixed (channel mean) into a mono buffer preallocated by the
+    // constructor, which is then converted; nothing is allocated per call. Channel layouts:
+    // interleaved: frame after frame, num_channels samples each
+    // planar: one pointer per channel, read from sample offset onwards
+    const std::vector<float>& resampleInterleaved(const float* input, int num_channels, long num_frames);
+    const std::vector<float>& resamplePlanar(const float* const* input, int num_channels, long offset, long num_frames);
 
-private:
-    struct CallbackData {
-        const float* input;
-        long total_frames;
-        long position;
-    };
+    bool isValid() const;
+    long getBufferSize() const;
 
-    static long callback(void* cb_data, float** data);
+    // delay introduced by the converter, in output samples
+    double getLatency() const;
 
-    CallbackData cb_data;
+private:
+    SRC_STATE* state;
     int error;
     double ratio;
     long buffer_size;
-    long output_frame_count;
+    long max_output_frames;
+    double latency;
+
+    std::vector<float> output_buffer;
+    std::vector<float> downmix_buffer; // bufferSize mono samples
+    std::vector<float> pending_input;  // input the converter did not consume, converted first next time
 
-    std::vector<float> silence, output_buffer;
+    // runs the converter until the input or output_buffer is used up, returns the input frames consumed
+    long convert(const float* input, long num_frames, long& generated);
 
     bool loadLibsamplerate();
     void* samplerate_handle = nullptr;
     const std::string dynamiclibname = "samplerate";
-    src_callback_new_t  callback_new = nullptr;
+    src_new_t           src_new = nullptr;
+    src_process_t       src_process = nullptr;
     src_strerror_t      strerror = nullptr;
-    src_callback_read_t callback_read = nullptr;
+    src_delete_t        src_delete = nullptr;
 
+    void measureLatency();
 };
-
-
-
-
-// SRC_STATE
-// src_callback_new
-// src_strerror
-// src_callback_read(state_, ratio, output_frame_count, output_buffer.data());
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "rtlog.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(10);
+    constexpr int64_t RATE_WINDOW_NS = 1000000000;
+
+    struct Record {
+        uint64_t sequence;
+        LogLevel level;
+        char text[RTLog::RECORD_SIZE - 16];
+    };
+    static_assert(sizeof(Record) == RTLog::RECORD_SIZE, "records are fixed size");
+
+    // Single producer (the thread that claimed it), single consumer (the drain). The indices only grow.
+    struct alignas(64) Ring {
+        std::atomic<bool> claimed { false };
+        std::atomic<size_t> head { 0 };             // written by the producer
+        std::atomic<long long> dropped { 0 };
+        alignas(64) std::atomic<size_t> tail { 0 }; // written by the drain
+        Record records[RTLog::RING_RECORDS];
+    };
+
+    class Logger {
+    public:
+        Logger():
+            rings(new Ring[RTLog::MAX_THREADS])
+        {
+            drain_thread = std::thread([this] {
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                while (!stopping) {
+                    lock.unlock();
+                    drain();
+                    lock.lock();
+                    wake.wait_for(lock, DRAIN_INTERVAL, [this] { return stopping; });
+                }
+            });
+        }
+
+        ~Logger()
+        {
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            drain_thread.join();
+            drain();
+        }
+
+        // Ring of the calling thread, claimed on its first message and given back when the thread ends.
+        // nullptr when every ring is taken.
+        Ring* threadRing()
+        {
+            struct Claim {
+                Ring* ring = nullptr;
+                bool tried = false;
+                ~Claim() { if (ring) ring->claimed.store(false, std::memory_order_release); }
+            };
+            thread_local Claim claim;
+            if (!claim.tried) {
+                claim.tried = true;
+                for (int i = 0; i < RTLog::MAX_THREADS && !claim.ring; ++i) {
+                    bool expected = false;
+                    if (rings[i].claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+                        claim.ring = &rings[i];
+                }
+            }
+            return claim.ring;
+        }
+
+        void push(LogLevel level, const char* format, va_list args, int suppressed)
+        {
+            Ring* ring = threadRing();
+            if (!ring) {
+                unclaimed_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            size_t head = ring->head.load(std::memory_order_relaxed);
+            if (head - ring->tail.load(std::memory_order_acquire) >= RTLog::RING_RECORDS) {
+                ring->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            Record& record = ring->records[head % RTLog::RING_RECORDS];
+            record.sequence = sequence.fetch_add(1, std::memory_order_relaxed);
+            record.level = level;
+            int length = std::vsnprintf(record.text, sizeof(record.text), format, args);
+            length = std::min(std::max(length, 0), static_cast<int>(sizeof(record.text)) - 1);
+            if (suppressed > 0)
+                std::snprintf(record.text + length, sizeof(record.text) - length, " (%d similar messages suppressed)", suppressed);
+            ring->head.store(head + 1, std::memory_order_release);
+        }
+
+        void drain()
+        {
+            std::lock_guard<std::mutex> lock(drain_mutex);
+            batch.clear();
+            long long dropped = unclaimed_dropped.exchange(0, std::memory_order_relaxed);
+            for (int i = 0; i < RTLog::MAX_THREADS; ++i) {
+                Ring& ring = rings[i];
+                size_t tail = ring.tail.load(std::memory_order_relaxed);
+                size_t head = ring.head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail)
+                    batch.push_back(ring.records[tail % RTLog::RING_RECORDS]);
+                ring.tail.store(tail, std::memory_order_release);
+                dropped += ring.dropped.exchange(0, std::memory_order_relaxed);
+            }
+            total_dropped += dropped;
+
+            // the rings are drained one after the other, the sequence restores the order across threads
+            std::sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) { return a.sequence < b.sequence; });
+            for (const Record& record : batch)
+                emit(record.level, record.text);
+            if (dropped > 0) {
+                char message[64];
+                std::snprintf(message, sizeof(message), "%lld log messages dropped", dropped);
+                emit(LogLevel::Warning, message);
+            }
+        }
+
+        void setSink(RTLog::Sink new_sink)
+        {
+            std::lock_guard<std::mutex> lock(drain_mutex);
+            sink = std::move(new_sink);
+        }
+
+        long long droppedMessages()
+        {
+            std::lock_guard<std::mutex> lock(drain_mutex);
+            return total_dropped + unclaimed_dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void emit(LogLevel level, const char* message)
+        {
+            if (sink)
+                sink(level, message);
+            else
+                std::cerr << message << std::endl;
+        }
+
+        std::unique_ptr<Ring[]> rings;
+        std::atomic<uint64_t> sequence { 0 };
+        std::atomic<long long> unclaimed_dropped { 0 };
+
+        std::mutex drain_mutex;             // drain() and the sink
+        std::vector<Record> batch;
+        RTLog::Sink sink;
+        long long total_dropped = 0;
+
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread drain_thread;
+    };
+
+    std::atomic<int> current_level { static_cast<int>(LogLevel::Warning) };
+
+    Logger& logger()
+    {
+        static Logger instance;
+        return instance;
+    }
+}
+
+void RTLog::start()
+{
+    logger();
+}
+
+void RTLog::setLevel(LogLevel level)
+{
+    current_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel RTLog::level()
+{
+    return static_cast<LogLevel>(current_level.load(std::memory_order_relaxed));
+}
+
+bool RTLog::enabled(LogLevel level)
+{
+    return level != LogLevel::Off && static_cast<int>(level) >= current_level.load(std::memory_order_relaxed);
+}
+
+void RTLog::setSink(Sink sink)
+{
+    logger().setSink(std::move(sink));
+}
+
+void RTLog::write(Site& site, LogLevel level, const char* format, ...)
+{
+    // at most MESSAGES_PER_SECOND per site and window; the next message after the window reports how many were
+    // left out. Concurrent writers may race on the window, which only shifts the count by a message or two.
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t window = site.window_start.load(std::memory_order_relaxed);
+    if (now - window >= RATE_WINDOW_NS && site.window_start.compare_exchange_strong(window, now, std::memory_order_relaxed))
+        site.messages.store(0, std::memory_order_relaxed);
+    if (site.messages.fetch_add(1, std::memory_order_relaxed) >= MESSAGES_PER_SECOND) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    int suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+
+    va_list args;
+    va_start(args, format);
+    logger().push(level, format, args, suppressed);
+    va_end(args);
+}
+
+void RTLog::flush()
+{
+    logger().drain();
+}
+
+long long RTLog::droppedMessages()
+{
+    return logger().droppedMessages();
+}
@@ -0,0 +1,75 @@
+#ifndef RT_LOG_H
+#define RT_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Logging that is safe to call from the audio thread. A message is formatted (snprintf, no allocation) into a
+// fixed-size record and pushed into a ring owned by the calling thread, which is wait free: no lock, no
+// system call, a full ring drops the message and counts it. A background thread drains the rings every few
+// milliseconds and hands the messages to the sink, stderr by default, in the order they were logged.
+//
+// The rings come from a pool allocated when the logger starts. Call RTLog::start() off the audio thread
+// (BeatNet and Resampler do in their constructors), otherwise the first message starts it.
+//
+// Use the macros, they filter by level before formatting and rate limit every call site:
+//     RTLOG_ERROR("libsamplerate error: %s", message);
+
+enum class LogLevel { Debug, Info, Warning, Error, Off };
+
+class RTLog {
+public:
+    using Sink = std::function<void(LogLevel level, const char* message)>;
+
+    static constexpr size_t RECORD_SIZE = 256;          // bytes per record, longer messages are truncated
+    static constexpr size_t RING_RECORDS = 128;         // per thread
+    static constexpr int MAX_THREADS = 32;              // threads that can log at the same time
+    static constexpr int MESSAGES_PER_SECOND = 5;       // per call site, the rest is counted and summarised
+
+    // Per call site rate limit, one static instance per RTLOG_ macro
+    struct Site {
+        std::atomic<int64_t> window_start { 0 };
+        std::atomic<int> messages { 0 };
+        std::atomic<int> suppressed { 0 };
+    };
+
+    // allocates the ring pool and starts the drain thread, idempotent
+    static void start();
+
+    static void setLevel(LogLevel level);
+    static LogLevel level();
+    static bool enabled(LogLevel level);
+
+    // Replaces the sink; it is called from the drain thread only. nullptr restores stderr.
+    static void setSink(Sink sink);
+
+    // printf-style; prefer the macros
+    static void write(Site& site, LogLevel level, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((format(printf, 3, 4)))
+#endif
+        ;
+
+    // drains every ring into the sink on the calling thread, e.g. before exiting
+    static void flush();
+
+    // messages lost to full rings or to an exhausted ring pool
+    static long long droppedMessages();
+};
+
+#define RTLOG_AT(level, ...) \
+    do { \
+        if (RTLog::enabled(level)) { \
+            static RTLog::Site rtlog_site; \
+            RTLog::write(rtlog_site, level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define RTLOG_DEBUG(...) RTLOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define RTLOG_INFO(...) RTLOG_AT(LogLevel::Info, __VA_ARGS__)
+#define RTLOG_WARNING(...) RTLOG_AT(LogLevel::Warning, __VA_ARGS__)
+#define RTLOG_ERROR(...) RTLOG_AT(LogLevel::Error, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,439 @@
+#include "staticfeaturepipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+
+namespace {
+
+    template<typename Geometry>
+    constexpr std::array<float, Geometry::frame_length> buildHannWindow() {
+        std::array<float, Geometry::frame_length> window {};
+        for (int i = 0; i < Geometry::frame_length; ++i)
+            window[i] = static_cast<float>(0.5 * (1.0 - ConstexprMath::cos(2.0 * ConstexprMath::PI * i / (Geometry::frame_length - 1))));
+        return window;
+    }
+
+    // Triangular filters of FilterBankProcessor, stored by offset from the first bin of each filter:
+    // weights[k][band] multiplies spectrum[start[band] + k]. Keeping the bands in the inner
+    // dimension gives the filterbank loop independent accumulators that the compiler can vectorise.
+    template<typename Geometry>
+    struct FilterTable {
+        std::array<int, Geometry::num_bands> start {};
+        std::array<std::array<float, Geometry::num_bands>, Geometry::filter_width> weights {};
+    };
+
+    template<typename Geometry>
+    constexpr FilterTable<Geometry> buildFilterTable() {
+        FilterTable<Geometry> table {};
+        for (int band = 0; band < Geometry::num_bands; ++band) {
+            float l = static_cast<float>(Geometry::hzToBin(Geometry::centre(band)));
+            float c = static_cast<float>(Geometry::hzToBin(Geometry::centre(band + 1)));
+            float r = static_cast<float>(Geometry::hzToBin(Geometry::centre(band + 2)));
+            int start = Geometry::filterStart(band);
+            int end = Geometry::filterEnd(band);
+            int peak = static_cast<int>(ConstexprMath::ceil(c));
+
+            table.start[band] = start;
+            double sum = 0.0;
+            for (int j = start; j < end; ++j) {
+                float weight = j < peak ? (j - l) / (c - l) : (r - j) / (r - c);
+                table.weights[j - start][band] = weight;
+                sum += weight;
+            }
+            if (sum > 0)
+                for (int j = start; j < end; ++j)
+                    table.weights[j - start][band] = static_cast<float>(table.weights[j - start][band] / sum);
+        }
+        return table;
+    }
+
+    template<typename Geometry>
+    constexpr std::array<float, Geometry::frame_length> hann_window = buildHannWindow<Geometry>();
+
+    template<typename Geometry>
+    constexpr FilterTable<Geometry> filter_table = buildFilterTable<Geometry>();
+}
+
+// StaticFramer
+
+template<typename Geometry>
+StaticFramer<Geometry>::StaticFramer()
+{
+    reset();
+}
+
+template<typename Geometry>
+void StaticFramer<Geometry>::reset()
+{
+    ring_buffer.fill(0.0f);
+    frame_out.fill(0.0f);
+    write_pos = 0;
+    total_samples_written = 0;
+    next_frame_end = Geometry::frame_length - Geometry::frame_length / 2;
+    frame_index = -1;
+}
+
+template<typename Geometry>
+int StaticFramer<Geometry>::process(const float* input, int num_samples, bool& frame_ready)
+{
+    constexpr int ring_size = Geometry::frame_length;
+
+    int to_consume = static_cast<int>(std::min<long long>(num_samples, next_frame_end - total_samples_written));
+    for (int i = 0; i < to_consume; ++i) {
+        ring_buffer[write_pos] = input[i];
+        write_pos = write_pos + 1 == ring_size ? 0 : write_pos + 1;
+    }
+    total_samples_written += to_consume;
+
+    frame_ready = total_samples_written == next_frame_end;
+    if (frame_ready) {
+        std::copy(ring_buffer.begin() + write_pos, ring_buffer.end(), frame_out.begin());
+        std::copy(ring_buffer.begin(), ring_buffer.begin() + write_pos, frame_out.begin() + (ring_size - write_pos));
+        next_frame_end += Geometry::hop_size;
+        frame_index++;
+    }
+    return to_consume;
+}
+
+template<typename Geometry>
+const typename StaticFramer<Geometry>::Frame& StaticFramer<Geometry>::frame() const
+{
+    return frame_out;
+}
+
+template<typename Geometry>
+long long StaticFramer<Geometry>::frameIndex() const
+{
+    return frame_index;
+}
+
+template<typename Geometry>
+long long StaticFramer<Geometry>::frameCentre() const
+{
+    return frame_index * Geometry::hop_size;
+}
+
+template<typename Geometry>
+long long StaticFramer<Geometry>::samplesWritten() const
+{
+    return total_samples_written;
+}
+
+// StaticFFT
+
+template<typename Geometry>
+StaticFFT<Geometry>::StaticFFT():
+    fft(Geometry::frame_size_pow2)
+{
+}
+
+template<typename Geometry>
+void StaticFFT<Geometry>::configure(FFTBackendType backend, bool exact_length)
+{
+    // RealFFT zeroes the input and the transform leaves it untouched, so the padding only needs to be written once
+    fft.configure(exact_length ? Geometry::frame_length : Geometry::frame_size_pow2, backend);
+}
+
+template<typename Geometry>
+const RealFFT& StaticFFT<Geometry>::transform() const
+{
+    return fft;
+}
+
+template<typename Geometry>
+void StaticFFT<Geometry>::process(const typename StaticFramer<Geometry>::Frame& frame, Spectrum& magnitudes)
+{
+    float* fft_input = fft.input();
+    if (!fft_input) {
+        magnitudes.fill(0.0f);
+        return;
+    }
+    const std::array<float, Geometry::frame_length>& window = hann_window<Geometry>;
+    for (int i = 0; i < Geometry::frame_length; ++i)
+        fft_input[i] = frame[i] * window[i];
+
+    fft.magnitudes(magnitudes.data(), Geometry::fft_size);
+}
+
+// StaticFilterBank
+
+template<typename Geometry>
+void StaticFilterBank<Geometry>::apply(const typename StaticFFT<Geometry>::Spectrum& spectrum, Bands& bands)
+{
+    const FilterTable<Geometry>& table = filter_table<Geometry>;
+    bands.fill(0.0f);
+    for (int k = 0; k < Geometry::filter_width; ++k) {
+        const std::array<float, Geometry::num_bands>& weights = table.weights[k];
+        for (int band = 0; band < Geometry::num_bands; ++band)
+            bands[band] += weights[band] * spectrum[table.start[band] + k];
+    }
+}
+
+// StaticLogDiff
+
+template<typename Geometry>
+StaticLogDiff<Geometry>::StaticLogDiff()
+{
+    reset();
+}
+
+template<typename Geometry>
+void StaticLogDiff<Geometry>::reset()
+{
+    prev_log_fb.fill(0.0f);
+    has_previous = false;
+}
+
+template<typename Geometry>
+void StaticLogDiff<Geometry>::skipSilent()
+{
+    // silent bands compress to log10(0 + 1) = 0
+    prev_log_fb.fill(0.0f);
+    has_previous = true;
+}
+
+template<typename Geometry>
+void StaticLogDiff<Geometry>::process(const typename StaticFilterBank<Geometry>::Bands& bands, Features& features)
+{
+    constexpr int num_bands = Geometry::num_bands;
+    float* log_fb = features.data();
+    float* diff = features.data() + num_bands;
+
+    for (int i = 0; i < num_bands; ++i)
+        log_fb[i] = std::log10(std::max(bands[i] + 1.0f, 1e-6f));
+
+    // first frame has no diff
+    for (int i = 0; i < num_bands; ++i)
+        diff[i] = has_previous ? std::max(0.0f, log_fb[i] - prev_log_fb[i]) : 0.0f;
+
+    std::copy(log_fb, log_fb + num_bands, prev_log_fb.begin());
+    has_previous = true;
+}
+
+// StaticFeaturePipeline
+
+template<typename Geometry>
+int StaticFeaturePipeline<Geometry>::process(const float* input, int num_samples, bool& frame_ready)
+{
+    return framer.process(input, num_samples, frame_ready);
+}
+
+template<typename Geometry>
+void StaticFeaturePipeline<Geometry>::computeFeatures(Features& features)
+{
+    fft.process(framer.frame(), spectrum);
+    StaticFilterBank<Geometry>::apply(spectrum, bands);
+    log_diff.process(bands, features);
+}
+
+template<typename Geometry>
+void StaticFeaturePipeline<Geometry>::skipFeatures()
+{
+    log_diff.skipSilent();
+}
+
+template<typename Geometry>
+const typename StaticFramer<Geometry>::Frame& StaticFeaturePipeline<Geometry>::frame() const
+{
+    return framer.frame();
+}
+
+template<typename Geometry>
+void StaticFeaturePipeline<Geometry>::reset()
+{
+    framer.reset();
+    log_diff.reset();
+}
+
+template<typename Geometry>
+void StaticFeaturePipeline<Geometry>::configureFFT(FFTBackendType backend, bool exact_length)
+{
+    fft.configure(backend, exact_length);
+}
+
+template<typename Geometry>
+const RealFFT& StaticFeaturePipeline<Geometry>::transform() const
+{
+    return fft.transform();
+}
+
+template<typename Geometry>
+long long StaticFeaturePipeline<Geometry>::frameIndex() const
+{
+    return framer.frameIndex();
+}
+
+template<typename Geometry>
+long long StaticFeaturePipeline<Geometry>::frameCentre() const
+{
+    return framer.frameCentre();
+}
+
+template<typename Geometry>
+long long StaticFeaturePipeline<Geometry>::samplesWritten() const
+{
+    return framer.samplesWritten();
+}
+
+// BatchSTFT
+
+template<typename Geometry>
+BatchSTFT<Geometry>::BatchSTFT(int num_threads, FFTBackendType backend)
+{
+    FFTBackendType type = backend == FFTBackendType::Auto ? FFTAutoTuner::choose(Geometry::frame_size_pow2) : backend;
+    for (int i = 0; i < std::max(1, num_threads); ++i) {
+        std::unique_ptr<FFTBackend> fft = FFTBackend::create(type, Geometry::frame_size_pow2);
+        if (!fft) {
+            std::cerr << "FFT backend " << FFTBackend::name(type) << " is not available, using builtin" << std::endl;
+            type = FFTBackendType::Builtin;
+            fft = FFTBackend::create(type, Geometry::frame_size_pow2);
+        }
+        backends.push_back(std::move(fft));
+    }
+    for (int slice = 1; slice < static_cast<int>(backends.size()); ++slice)
+        workers.emplace_back(&BatchSTFT::workerLoop, this, slice);
+}
+
+template<typename Geometry>
+BatchSTFT<Geometry>::~BatchSTFT()
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+template<typename Geometry>
+void BatchSTFT<Geometry>::workerLoop(int slice)
+{
+    long long done_job = 0;
+    int applied_placement = 0;
+    for (;;) {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        work_ready.wait(lock, [&] { return stopping || job != done_job; });
+        if (stopping)
+            return;
+        done_job = job;
+        if (applied_placement != placement_version) {
+            applied_placement = placement_version;
+            if (!worker_placement.isDefault())
+                applyThreadPlacement(worker_placement);
+        }
+        const long long first = slice * job_per_slice;
+        const long long count = std::min(job_per_slice, job_frames - first);
+        lock.unlock();
+
+        if (count > 0)
+            processSlice(slice, job_signal, first, count, *job_spectra);
+
+        lock.lock();
+        if (--busy_workers == 0)
+            work_done.notify_one();
+    }
+}
+
+template<typename Geometry>
+long long BatchSTFT<Geometry>::numFrames(long long num_samples)
+{
+    constexpr long long first_frame_end = Geometry::frame_length - Geometry::frame_length / 2;
+    return num_samples < first_frame_end ? 0 : (num_samples - first_frame_end) / Geometry::hop_size + 1;
+}
+
+template<typename Geometry>
+void BatchSTFT<Geometry>::process(const float* signal, long long num_samples, std::vector<Spectrum>& spectra)
+{
+    constexpr size_t alignment = 64;
+    const long long num_frames = numFrames(num_samples);
+    spectra.resize(static_cast<size_t>(num_frames));
+    if (num_frames == 0)
+        return;
+
+    // one contiguous buffer for all frames, each row starts on a cache line since frame_size_pow2 floats is a multiple of it
+    size_t required = static_cast<size_t>(num_frames) * Geometry::frame_size_pow2 + alignment / sizeof(float);
+    if (frame_storage.size() < required)
+        frame_storage.resize(required);
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(frame_storage.data());
+    frames = frame_storage.data() + ((alignment - address % alignment) % alignment) / sizeof(float);
+
+    const long long num_slices = std::min<long long>(static_cast<long long>(backends.size()), num_frames);
+    const long long per_slice = (num_frames + num_slices - 1) / num_slices;
+    if (!workers.empty()) {
+        // workers whose slice starts past the last frame wake up and find nothing to do
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        job_signal = signal;
+        job_frames = num_frames;
+        job_per_slice = per_slice;
+        job_spectra = &spectra;
+        busy_workers = static_cast<int>(workers.size());
+        job++;
+    }
+    work_ready.notify_all();
+    processSlice(0, signal, 0, std::min(per_slice, num_frames), spectra);
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    work_done.wait(lock, [this] { return busy_workers == 0; });
+}
+
+template<typename Geometry>
+void BatchSTFT<Geometry>::setWorkerPlacement(const ThreadPlacement& placement)
+{
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    worker_placement = placement;
+    placement_version++;
+}
+
+template<typename Geometry>
+void BatchSTFT<Geometry>::processSlice(int slice, const float* signal, long long first_frame, long long num_frames,
+                                       std::vector<Spectrum>& spectra)
+{
+    static_assert(sizeof(Spectrum) == sizeof(float) * std::tuple_size<Spectrum>::value, "spectra must be contiguous floats");
+    const std::array<float, Geometry::frame_length>& window = hann_window<Geometry>;
+    float* slice_frames = frames + static_cast<size_t>(first_frame) * Geometry::frame_size_pow2;
+
+    // frame k is centred at k * hop_size, samples before the start of the signal are zero (as in StaticFramer)
+    for (long long k = 0; k < num_frames; ++k) {
+        float* frame = slice_frames + static_cast<size_t>(k) * Geometry::frame_size_pow2;
+        long long start = (first_frame + k) * Geometry::hop_size - Geometry::frame_length / 2;
+        int skip = static_cast<int>(std::max(0LL, -start));
+        std::fill(frame, frame + skip, 0.0f);
+        for (int i = skip; i < Geometry::frame_length; ++i)
+            frame[i] = signal[start + i] * window[i];
+        std::fill(frame + Geometry::frame_length, frame + Geometry::frame_size_pow2, 0.0f);
+    }
+
+    Spectrum* output = spectra.data() + first_frame;
+    backends[slice]->magnitudesBatch(slice_frames, static_cast<int>(num_frames), Geometry::frame_size_pow2,
+                                     output->data(), static_cast<int>(std::tuple_size<Spectrum>::value), Geometry::fft_size);
+    for (long long k = 0; k < num_frames; ++k)
+        std::fill(output[k].begin() + Geometry::fft_size, output[k].end(), 0.0f);
+}
+
+template<typename Geometry>
+int BatchSTFT<Geometry>::numThreads() const
+{
+    return static_cast<int>(backends.size());
+}
+
+template<typename Geometry>
+const char* BatchSTFT<Geometry>::backendName() const
+{
+    return FFTBackend::name(backends.front()->type());
+}
+
+template class StaticFramer<GithubGeometry>;
+template class StaticFFT<GithubGeometry>;
+template class StaticFilterBank<GithubGeometry>;
+template class StaticLogDiff<GithubGeometry>;
+template class StaticFeaturePipeline<GithubGeometry>;
+template class BatchSTFT<GithubGeometry>;
+
+template class StaticFramer<PaperGeometry>;
+template class StaticFFT<PaperGeometry>;
+template class StaticFilterBank<PaperGeometry>;
+template class StaticLogDiff<PaperGeometry>;
+template class StaticFeaturePipeline<PaperGeometry>;
+template class BatchSTFT<PaperGeometry>;
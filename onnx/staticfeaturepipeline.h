@@ -0,0 +1,185 @@
+#ifndef STATIC_FEATURE_PIPELINE_H
+#define STATIC_FEATURE_PIPELINE_H
+
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "featuregeometry.h"
+#include "realfft.h"
+#include "threadconfig.h"
+
+// Compile-time specialised versions of FramedSignalProcessor, FFTProcessor, FilterBankProcessor
+// and the log/diff utilities. Every size is a template parameter, buffers are std::arrays and
+// the Hann window and filterbank tables are computed by the compiler.
+// Instantiated for GithubGeometry and PaperGeometry in staticfeaturepipeline.cpp.
+
+template<typename Geometry>
+class StaticFramer {
+public:
+    using Frame = std::array<float, Geometry::frame_length>;
+
+    StaticFramer();
+
+    // same contract as FramedSignalProcessor::process
+    int process(const float* input, int num_samples, bool& frame_ready);
+    const Frame& frame() const;
+    void reset();
+
+    long long frameIndex() const;
+    long long frameCentre() const;
+    long long samplesWritten() const;
+
+private:
+    std::array<float, Geometry::frame_length> ring_buffer;
+    Frame frame_out;
+    int write_pos;
+    long long total_samples_written;
+    long long next_frame_end;
+    long long frame_index;
+};
+
+template<typename Geometry>
+class StaticFFT {
+public:
+    // zero padded so that every filter of the filterbank can read filter_width bins from its start
+    using Spectrum = std::array<float, Geometry::fft_size + Geometry::filter_width>;
+
+    StaticFFT();
+
+    // exact_length transforms the frame_length samples without zero padding to frame_size_pow2.
+    // Allocates, not real time safe.
+    void configure(FFTBackendType backend, bool exact_length);
+    void process(const typename StaticFramer<Geometry>::Frame& frame, Spectrum& magnitudes);
+
+    const RealFFT& transform() const;
+
+private:
+    RealFFT fft;
+};
+
+template<typename Geometry>
+class StaticFilterBank {
+public:
+    using Bands = std::array<float, Geometry::num_bands>;
+
+    static void apply(const typename StaticFFT<Geometry>::Spectrum& spectrum, Bands& bands);
+};
+
+template<typename Geometry>
+class StaticLogDiff {
+public:
+    using Features = std::array<float, Geometry::feature_size>;
+
+    StaticLogDiff();
+
+    // log compression of the bands followed by their positive difference to the previous frame, stacked
+    void process(const typename StaticFilterBank<Geometry>::Bands& bands, Features& features);
+    void reset();
+    // continues the history as if a silent frame had been processed
+    void skipSilent();
+
+private:
+    std::array<float, Geometry::num_bands> prev_log_fb;
+    bool has_previous;
+};
+
+template<typename Geometry>
+class StaticFeaturePipeline {
+public:
+    using Features = typename StaticLogDiff<Geometry>::Features;
+
+    // feeds the framer, see FramedSignalProcessor::process
+    int process(const float* input, int num_samples, bool& frame_ready);
+    // features of the frame completed by the last process() call
+    void computeFeatures(Features& features);
+    // instead of computeFeatures for a frame that is treated as silence (see EnergyGate)
+    void skipFeatures();
+    void reset();
+
+    const typename StaticFramer<Geometry>::Frame& frame() const;
+
+    // see StaticFFT::configure
+    void configureFFT(FFTBackendType backend, bool exact_length);
+    const RealFFT& transform() const;
+
+    long long frameIndex() const;
+    long long frameCentre() const;
+    long long samplesWritten() const;
+
+private:
+    StaticFramer<Geometry> framer;
+    StaticFFT<Geometry> fft;
+    typename StaticFFT<Geometry>::Spectrum spectrum {};
+    typename StaticFilterBank<Geometry>::Bands bands {};
+    StaticLogDiff<Geometry> log_diff;
+};
+
+// Offline counterpart of StaticFramer + StaticFFT: windows every frame of a whole (resampled) signal into one
+// aligned [frames, frame_size_pow2] buffer and transforms them in one batch per thread.
+// Produces the same frames as streaming the signal through StaticFramer.
+// The constructor starts num_threads - 1 workers that wait between process() calls; the calling thread
+// transforms the first slice itself.
+template<typename Geometry>
+class BatchSTFT {
+public:
+    using Spectrum = typename StaticFFT<Geometry>::Spectrum;
+
+    explicit BatchSTFT(int num_threads = 1, FFTBackendType backend = FFTBackendType::Auto);
+    ~BatchSTFT();
+    BatchSTFT(const BatchSTFT&) = delete;
+    BatchSTFT& operator=(const BatchSTFT&) = delete;
+
+    // frames StaticFramer emits for a signal of num_samples samples
+    static long long numFrames(long long num_samples);
+
+    // spectra is resized to numFrames(num_samples), in the layout StaticFilterBank::apply reads
+    void process(const float* signal, long long num_samples, std::vector<Spectrum>& spectra);
+
+    int numThreads() const;
+    const char* backendName() const;
+
+    // applied by the workers before their next slice; the calling thread is left alone
+    void setWorkerPlacement(const ThreadPlacement& placement);
+
+private:
+    void workerLoop(int slice);
+    void processSlice(int slice, const float* signal, long long first_frame, long long num_frames, std::vector<Spectrum>& spectra);
+
+    std::vector<std::unique_ptr<FFTBackend>> backends; // one per thread
+    std::vector<float> frame_storage;
+    float* frames = nullptr; // frame_storage aligned to a cache line
+
+    // the worker pool and the call it is working on
+    std::vector<std::thread> workers;
+    std::mutex pool_mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    long long job = 0;                  // number of process() calls handed to the workers
+    int busy_workers = 0;
+    bool stopping = false;
+    const float* job_signal = nullptr;
+    long long job_frames = 0;
+    long long job_per_slice = 0;
+    std::vector<Spectrum>* job_spectra = nullptr;
+    ThreadPlacement worker_placement;
+    int placement_version = 0;          // incremented by setWorkerPlacement
+};
+
+extern template class StaticFramer<GithubGeometry>;
+extern template class StaticFFT<GithubGeometry>;
+extern template class StaticFilterBank<GithubGeometry>;
+extern template class StaticLogDiff<GithubGeometry>;
+extern template class StaticFeaturePipeline<GithubGeometry>;
+extern template class BatchSTFT<GithubGeometry>;
+
+extern template class StaticFramer<PaperGeometry>;
+extern template class StaticFFT<PaperGeometry>;
+extern template class StaticFilterBank<PaperGeometry>;
+extern template class StaticLogDiff<PaperGeometry>;
+extern template class StaticFeaturePipeline<PaperGeometry>;
+extern template class BatchSTFT<PaperGeometry>;
+
+#endif
@@ -0,0 +1,91 @@
+#include "tempoestimator.h"
+#include <algorithm>
+#include <cmath>
+
+TempoEstimator::TempoEstimator(double frame_rate, double min_bpm, double max_bpm, double window_seconds):
+    frame_rate(frame_rate),
+    min_lag(std::max(1, static_cast<int>(std::floor(60.0 * frame_rate / max_bpm)))),
+    max_lag(static_cast<int>(std::ceil(60.0 * frame_rate / min_bpm))),
+    num_lags(2 * max_lag + 2),
+    decay(static_cast<float>(std::exp(-1.0 / (window_seconds * frame_rate)))),
+    mean_decay(static_cast<float>(std::exp(-1.0 / (2.0 * frame_rate)))),
+    warmup_frames(static_cast<long long>(window_seconds * frame_rate / 2)),
+    history(2 * num_lags, 0.0f),
+    correlation(num_lags, 0.0f)
+{
+    reset();
+}
+
+void TempoEstimator::reset()
+{
+    mean = 0.0f;
+    frames = 0;
+    write_pos = num_lags;
+    std::fill(history.begin(), history.end(), 0.0f);
+    std::fill(correlation.begin(), correlation.end(), 0.0f);
+    current_tempo.store(0.0, std::memory_order_relaxed);
+    current_confidence.store(0.0f, std::memory_order_relaxed);
+}
+
+void TempoEstimator::process(float activation)
+{
+    // remove the slowly varying level, otherwise every lag correlates with the offset
+    mean = mean_decay * mean + (1.0f - mean_decay) * activation;
+    float x = activation - mean;
+
+    // newest sample at write_pos, the lag l sample at write_pos + l
+    write_pos = write_pos == 0 ? num_lags - 1 : write_pos - 1;
+    history[write_pos] = x;
+    history[write_pos + num_lags] = x;
+    const float* past = history.data() + write_pos;
+
+    float* r = correlation.data();
+    for (int lag = 0; lag < num_lags; ++lag)
+        r[lag] = decay * r[lag] + x * past[lag];
+
+    if (++frames < warmup_frames || r[0] <= 0.0f)
+        return;
+
+    int best = min_lag;
+    float best_score = score(min_lag);
+    for (int lag = min_lag + 1; lag <= max_lag; ++lag) {
+        float lag_score = score(lag);
+        if (lag_score > best_score) {
+            best_score = lag_score;
+            best = lag;
+        }
+    }
+
+    // parabolic interpolation for a lag between the integer ones
+    double offset = 0.0;
+    if (best > min_lag && best < max_lag) {
+        float left = score(best - 1);
+        float right = score(best + 1);
+        float curvature = left - 2.0f * best_score + right;
+        if (curvature < 0.0f)
+            offset = 0.5 * (left - right) / curvature;
+    }
+
+    current_tempo.store(60.0 * frame_rate / (best + offset), std::memory_order_relaxed);
+    current_confidence.store(std::clamp(best_score / (1.5f * r[0]), 0.0f, 1.0f), std::memory_order_relaxed);
+}
+
+float TempoEstimator::score(int lag) const
+{
+    // A pulse at lag l also correlates at 2l, so the comb adds half of it. The same holds for a pulse at
+    // l / 2, which would make l look like the beat while it is a bar level; strong correlation at half the
+    // lag counts against it.
+    const float* r = correlation.data();
+    float half = 0.5f * (r[lag / 2] + r[(lag + 1) / 2]);
+    return r[lag] + 0.5f * r[2 * lag] - 0.5f * std::max(0.0f, half);
+}
+
+double TempoEstimator::tempo() const
+{
+    return current_tempo.load(std::memory_order_relaxed);
+}
+
+float TempoEstimator::confidence() const
+{
+    return current_confidence.load(std::memory_order_relaxed);
+}
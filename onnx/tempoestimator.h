@@ -0,0 +1,45 @@
+#ifndef TEMPO_ESTIMATOR_H
+#define TEMPO_ESTIMATOR_H
+
+#include <atomic>
+#include <vector>
+
+// Lightweight tempo tracker on the beat activation stream, for consumers that only need a BPM value.
+// Keeps an exponentially decaying autocorrelation of the (mean removed) activation over all lags of the
+// tempo range and their doubles, and picks the lag with the strongest comb response (see score()).
+// Memory and per-frame cost are fixed:
+// one multiply-add per lag, in loops over contiguous arrays the compiler vectorises.
+class TempoEstimator {
+public:
+    TempoEstimator(double frame_rate = 50.0, double min_bpm = 55.0, double max_bpm = 215.0, double window_seconds = 8.0);
+
+    void reset();
+    void process(float activation);
+
+    // beats per minute, 0 until a window worth of activations has been seen; may be read from any thread
+    double tempo() const;
+    // 0..1, how much of the activation energy is periodic at the reported tempo
+    float confidence() const;
+
+private:
+    float score(int lag) const;
+
+    double frame_rate;
+    int min_lag;
+    int max_lag;
+    int num_lags;           // autocorrelation lags 0..num_lags - 1, covering the doubles of the tempo range
+    float decay;
+    float mean_decay;
+    long long warmup_frames;
+
+    float mean;
+    long long frames;
+    std::vector<float> history;      // newest first, written twice so that the last num_lags values are contiguous
+    int write_pos;
+    std::vector<float> correlation;
+
+    std::atomic<double> current_tempo;
+    std::atomic<float> current_confidence;
+};
+
+#endif
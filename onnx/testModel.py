@@ -7,5 +7,10 @@ input_name = sess.get_inputs()[0].name
 # Make sure input is NumPy float32
 input_array = np.random.randn(1, 1, 272).astype(np.float32)
 
-outputs = sess.run(None, {input_name: input_array})
+feeds = {input_name: input_array}
+# models exported with the LSTM state take it as extra inputs, start from zeros
+for state_input in sess.get_inputs()[1:]:
+    feeds[state_input.name] = np.zeros((2, 1, 150), dtype=np.float32)
+
+outputs = sess.run(None, feeds)
 print("Output shape:", outputs[0].shape)
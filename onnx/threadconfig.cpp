@@ -0,0 +1,106 @@
+#include "threadconfig.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    std::atomic<bool> affinity_warned { false };
+    std::atomic<bool> scheduling_warned { false };
+
+    void warnOnce(std::atomic<bool>& warned, const std::string& message)
+    {
+        if (!warned.exchange(true))
+            std::cerr << message << std::endl;
+    }
+
+    bool applyAffinity(const std::vector<int>& cores)
+    {
+        if (cores.empty())
+            return true;
+#if defined(_WIN32)
+        DWORD_PTR mask = 0;
+        for (int core : cores)
+            if (core >= 0 && core < static_cast<int>(sizeof(DWORD_PTR) * 8))
+                mask |= static_cast<DWORD_PTR>(1) << core;
+        if (mask && SetThreadAffinityMask(GetCurrentThread(), mask))
+            return true;
+        warnOnce(affinity_warned, "Could not set the thread affinity.");
+        return false;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int core : cores)
+            if (core >= 0 && core < CPU_SETSIZE)
+                CPU_SET(core, &set);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error == 0)
+            return true;
+        warnOnce(affinity_warned, std::string("Could not set the thread affinity: ") + std::strerror(error));
+        return false;
+#else
+        warnOnce(affinity_warned, "Thread affinity is not supported on this platform, ignoring it.");
+        return false;
+#endif
+    }
+
+    bool applyScheduling(SchedulingPolicy policy, int priority)
+    {
+        if (policy == SchedulingPolicy::Normal)
+            return true;
+#ifdef _WIN32
+        // no FIFO/RR distinction for threads, map to the time critical class
+        if (SetThreadPriority(GetCurrentThread(), priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST))
+            return true;
+        warnOnce(scheduling_warned, "Could not raise the thread priority.");
+        return false;
+#else
+        int native = policy == SchedulingPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+        sched_param param {};
+        param.sched_priority = std::clamp(priority, sched_get_priority_min(native), sched_get_priority_max(native));
+        int error = pthread_setschedparam(pthread_self(), native, &param);
+        if (error == 0)
+            return true;
+        warnOnce(scheduling_warned, std::string("Could not use real-time scheduling, running with normal priority: ")
+                 + std::strerror(error));
+        return false;
+#endif
+    }
+}
+
+bool applyThreadPlacement(const ThreadPlacement& placement)
+{
+    bool affinity = applyAffinity(placement.cores);
+    bool scheduling = applyScheduling(placement.policy, placement.priority);
+    return affinity && scheduling;
+}
+
+std::vector<int> parseCoreList(const std::string& list)
+{
+    std::vector<int> cores;
+    std::stringstream stream(list);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+        int first = 0, last = 0;
+        char dash = 0;
+        std::stringstream range(entry);
+        if (!(range >> first))
+            continue;
+        last = first;
+        if (range >> dash && (dash != '-' || !(range >> last)))
+            continue;
+        for (int core = std::max(0, first); core <= last; ++core)
+            cores.push_back(core);
+    }
+    std::sort(cores.begin(), cores.end());
+    cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+    return cores;
+}
@@ -0,0 +1,35 @@
+#ifndef THREAD_CONFIG_H
+#define THREAD_CONFIG_H
+
+#include <string>
+#include <vector>
+
+enum class SchedulingPolicy { Normal, Fifo, RoundRobin };
+
+// Where and how a group of threads runs.
+struct ThreadPlacement {
+    std::vector<int> cores;     // CPUs the threads may run on, empty for no restriction
+    SchedulingPolicy policy = SchedulingPolicy::Normal;
+    int priority = 0;           // real-time priority for Fifo and RoundRobin, clamped to the range of the policy
+
+    bool isDefault() const { return cores.empty() && policy == SchedulingPolicy::Normal; }
+};
+
+// Threading of the ONNX Runtime session of a BeatNet instance.
+struct ThreadConfig {
+    int intra_op_threads = 1;   // threads working on one operator, counting the thread that calls process()
+    int inter_op_threads = 1;   // threads running independent operators, 1 runs the graph sequentially
+    bool allow_spinning = true; // idle ORT threads busy-wait for work: lower wake-up latency, but they burn their cores
+    ThreadPlacement inference;  // the threads ORT starts; the thread calling process() is placed by the host
+};
+
+// Applies a placement to the calling thread. This is best effort: when the platform has no affinity
+// control (macOS) or the process may not use real-time scheduling (SCHED_FIFO usually needs CAP_SYS_NICE
+// or an rtprio limit), a warning is printed once and the thread carries on with what could be applied.
+// Returns whether everything was applied.
+bool applyThreadPlacement(const ThreadPlacement& placement);
+
+// "0,2,4-7" style CPU lists as taken by taskset, invalid entries are skipped
+std::vector<int> parseCoreList(const std::string& list);
+
+#endif
@@ -0,0 +1,226 @@
+#include "tracefile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    constexpr size_t WINDOW_BYTES = 4u << 20;
+
+    size_t paddedSamples(uint32_t num_samples)
+    {
+        return (static_cast<size_t>(num_samples) + 1) / 2 * 2;
+    }
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    if (isOpen())
+        close();
+}
+
+bool TraceRecorder::open(const std::string& path, uint32_t flags)
+{
+    header = {};
+    std::memcpy(header.magic, "BNTRACE", 8);
+    header.version = FILE_VERSION;
+    header.flags = flags;
+    header.feature_size = FBANK_SIZE;
+    header.num_classes = 3;
+    header.frame_rate = static_cast<double>(SR_BEATNET) / HOP_SIZE;
+
+    samples.clear();
+    waiting.clear();
+    completed.clear();
+    // enough for any block of a usual host; larger ones grow once
+    samples.reserve(SR_BEATNET / 10);
+    waiting.reserve(64);
+    completed.reserve(64);
+
+    ok = writer.open(path, WINDOW_BYTES) && writer.write(&header, sizeof(header));
+    return ok;
+}
+
+bool TraceRecorder::isOpen() const
+{
+    return writer.isOpen();
+}
+
+uint32_t TraceRecorder::flags() const
+{
+    return header.flags;
+}
+
+bool TraceRecorder::close()
+{
+    if (!isOpen())
+        return false;
+    ok = ok && writer.writeAt(0, &header, sizeof(header));
+    ok = writer.close() && ok;
+    if (!ok)
+        std::cerr << "Failed to write the trace" << std::endl;
+    return ok;
+}
+
+void TraceRecorder::beginBlock(double sample_rate, long num_frames, int num_channels)
+{
+    block = {};
+    block.block_index = header.num_blocks;
+    block.sample_rate = sample_rate;
+    block.num_frames = static_cast<uint32_t>(num_frames);
+    block.num_channels = static_cast<uint32_t>(num_channels);
+    samples.clear();
+    completed.clear();
+}
+
+void TraceRecorder::addSamples(const float* data, int num_samples)
+{
+    if (header.flags & TraceAudio)
+        samples.insert(samples.end(), data, data + num_samples);
+}
+
+void TraceRecorder::addHop(long long centre, TraceHopSource source, const float* features)
+{
+    TraceHop hop {};
+    hop.centre = centre;
+    hop.source = source;
+    if (features)
+        std::copy(features, features + FBANK_SIZE, hop.features);
+    waiting.push_back(hop);
+}
+
+void TraceRecorder::addOutput(const float* output)
+{
+    if (waiting.empty())
+        return;
+    TraceHop& hop = waiting.front();
+    std::copy(output, output + 3, hop.output);
+    completed.push_back(hop);
+    waiting.erase(waiting.begin());
+}
+
+void TraceRecorder::endBlock(double process_seconds)
+{
+    if (!ok)
+        return;
+    block.num_samples = static_cast<uint32_t>(samples.size());
+    block.num_hops = static_cast<uint32_t>(completed.size());
+    block.process_seconds = (header.flags & TraceTiming) ? process_seconds : 0.0;
+    samples.resize(paddedSamples(block.num_samples), 0.0f);
+
+    ok = writer.write(&block, sizeof(block))
+        && writer.write(samples.data(), samples.size() * sizeof(float))
+        && writer.write(completed.data(), completed.size() * sizeof(TraceHop));
+    header.num_blocks++;
+    header.num_hops += completed.size();
+}
+
+bool TraceReader::open(const std::string& path)
+{
+    block_offsets.clear();
+    if (!file.open(path))
+        return false;
+
+    const char* data = file.data();
+    const size_t size = file.size();
+    if (size < sizeof(TraceFileHeader)) {
+        std::cerr << path << " is not a trace" << std::endl;
+        return false;
+    }
+    std::memcpy(&file_header, data, sizeof(file_header));
+    if (std::memcmp(file_header.magic, "BNTRACE", 8) != 0 || file_header.version != TraceRecorder::FILE_VERSION
+        || file_header.feature_size != FBANK_SIZE || file_header.num_classes != 3) {
+        std::cerr << path << " is not a trace of this version" << std::endl;
+        return false;
+    }
+
+    size_t offset = sizeof(TraceFileHeader);
+    for (uint64_t index = 0; index < file_header.num_blocks; ++index) {
+        if (size - offset < sizeof(TraceBlock))
+            break;
+        const TraceBlock* info = reinterpret_cast<const TraceBlock*>(data + offset);
+        size_t length = sizeof(TraceBlock) + paddedSamples(info->num_samples) * sizeof(float)
+                        + static_cast<size_t>(info->num_hops) * sizeof(TraceHop);
+        if (size - offset < length)
+            break;
+        block_offsets.push_back(offset);
+        offset += length;
+    }
+    if (block_offsets.size() != file_header.num_blocks) {
+        std::cerr << path << " is truncated after " << block_offsets.size() << " blocks" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const TraceFileHeader& TraceReader::header() const
+{
+    return file_header;
+}
+
+size_t TraceReader::numBlocks() const
+{
+    return block_offsets.size();
+}
+
+TraceReader::Block TraceReader::block(size_t index) const
+{
+    const char* start = file.data() + block_offsets[index];
+    const TraceBlock* info = reinterpret_cast<const TraceBlock*>(start);
+    const float* samples = reinterpret_cast<const float*>(start + sizeof(TraceBlock));
+    const TraceHop* hops = reinterpret_cast<const TraceHop*>(samples + paddedSamples(info->num_samples));
+    return { info, samples, hops };
+}
+
+bool compareTraces(const TraceReader& expected, const TraceReader& actual, float tolerance, std::ostream& report)
+{
+    const int max_reports = 10;
+    int differences = 0;
+    long long hop_index = 0;
+    float max_feature_error = 0.0f, max_output_error = 0.0f;
+
+    auto mismatch = [&](const char* what, long long centre) {
+        if (differences++ < max_reports)
+            report << "hop " << hop_index << " (centre " << centre << "): " << what << " differs\n";
+    };
+
+    size_t block_a = 0, block_b = 0;
+    uint32_t hop_a = 0, hop_b = 0;
+    for (;;) {
+        // next hop of each trace, skipping blocks without hops
+        while (block_a < expected.numBlocks() && hop_a == expected.block(block_a).info->num_hops) { block_a++; hop_a = 0; }
+        while (block_b < actual.numBlocks() && hop_b == actual.block(block_b).info->num_hops) { block_b++; hop_b = 0; }
+        bool has_a = block_a < expected.numBlocks(), has_b = block_b < actual.numBlocks();
+        if (!has_a || !has_b) {
+            if (has_a != has_b) {
+                report << (has_a ? "actual" : "expected") << " trace ends after " << hop_index << " hops\n";
+                differences++;
+            }
+            break;
+        }
+
+        const TraceHop& a = expected.block(block_a).hops[hop_a++];
+        const TraceHop& b = actual.block(block_b).hops[hop_b++];
+        if (a.centre != b.centre)
+            mismatch("centre", a.centre);
+        if (a.source != b.source)
+            mismatch("source", a.centre);
+
+        float feature_error = 0.0f, output_error = 0.0f;
+        for (int i = 0; i < FBANK_SIZE; ++i)
+            feature_error = std::max(feature_error, std::abs(a.features[i] - b.features[i]));
+        for (int i = 0; i < 3; ++i)
+            output_error = std::max(output_error, std::abs(a.output[i] - b.output[i]));
+        if (feature_error > tolerance)
+            mismatch("features", a.centre);
+        if (output_error > tolerance)
+            mismatch("output", a.centre);
+        max_feature_error = std::max(max_feature_error, feature_error);
+        max_output_error = std::max(max_output_error, output_error);
+        hop_index++;
+    }
+
+    report << hop_index << " hops compared, " << differences << " differences, max feature error "
+           << max_feature_error << ", max output error " << max_output_error << "\n";
+    return differences == 0;
+}
@@ -0,0 +1,118 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "featuregeometry.h"
+#include "mappedfile.h"
+
+// Traces record what a BeatNet instance saw and produced, block by block, without the host audio:
+// optionally the resampled mono signal at SR_BEATNET, and for every hop its feature row and model output.
+// They can be replayed into the tracker from the framer onwards (see TraceReplayer).
+//
+// Layout, native byte order: TraceFileHeader, then num_blocks times a TraceBlock followed by its
+// num_samples floats (padded to a multiple of 8 bytes) and num_hops TraceHop records. Every record
+// starts 8 byte aligned, so a mapped file can be read in place.
+
+enum TraceFlags : uint32_t {
+    TraceAudio = 1u << 0,   // the resampled signal is recorded, needed to replay from the framer
+    TraceTiming = 1u << 1   // process() durations are recorded; leave out for byte-identical traces
+};
+
+enum class TraceHopSource : uint32_t {
+    Model = 0,      // the model ran on the features
+    Silence = 1,    // gated by the energy gate, no features
+    Repeat = 2      // skipped by the load shedder, the previous output was repeated
+};
+
+struct TraceFileHeader {
+    char magic[8];          // "BNTRACE" and a terminating zero
+    uint32_t version;
+    uint32_t flags;         // TraceFlags
+    uint32_t feature_size;
+    uint32_t num_classes;
+    double frame_rate;      // hops per second
+    uint64_t num_blocks;
+    uint64_t num_hops;
+};
+
+// One process() call
+struct TraceBlock {
+    uint64_t block_index;
+    double sample_rate;     // of the host
+    uint32_t num_frames;    // host frames in the block
+    uint32_t num_channels;
+    uint32_t num_samples;   // resampled samples that follow, 0 without TraceAudio
+    uint32_t num_hops;      // hops whose output was produced during the block
+    double process_seconds; // 0 without TraceTiming
+};
+
+struct TraceHop {
+    int64_t centre;         // frame centre in samples at SR_BEATNET
+    TraceHopSource source;
+    float output[3];        // beat, downbeat, non-beat
+    float features[FBANK_SIZE];
+};
+
+static_assert(sizeof(TraceBlock) % 8 == 0 && sizeof(TraceHop) % 8 == 0, "trace records must keep 8 byte alignment");
+
+// Written by BeatNet (see BeatNet::setTraceRecorder) from the thread calling process(). Recording maps and
+// writes the file on that thread, so it is meant for diagnosis, not for a real-time audio thread.
+class TraceRecorder {
+public:
+    TraceRecorder() = default;
+    ~TraceRecorder();
+
+    bool open(const std::string& path, uint32_t flags = TraceAudio);
+    bool isOpen() const;
+    uint32_t flags() const;
+    // writes the totals into the header and closes the file
+    bool close();
+
+    void beginBlock(double sample_rate, long num_frames, int num_channels);
+    void addSamples(const float* samples, int num_samples);
+    // hops are added when their features are computed and get their output later, in the same order
+    void addHop(long long centre, TraceHopSource source, const float* features);
+    void addOutput(const float* output);
+    void endBlock(double process_seconds);
+
+    static constexpr uint32_t FILE_VERSION = 1;
+
+private:
+    MappedFileWriter writer;
+    TraceFileHeader header {};
+    TraceBlock block {};
+    bool ok = false;
+    std::vector<float> samples;
+    std::vector<TraceHop> waiting;      // hops without output yet
+    std::vector<TraceHop> completed;    // hops that got their output during the current block
+};
+
+// Maps a trace and indexes its blocks.
+class TraceReader {
+public:
+    struct Block {
+        const TraceBlock* info;
+        const float* samples;
+        const TraceHop* hops;
+    };
+
+    // checks the header and every record against the file size
+    bool open(const std::string& path);
+    const TraceFileHeader& header() const;
+    size_t numBlocks() const;
+    Block block(size_t index) const;
+
+private:
+    MappedFileReader file;
+    TraceFileHeader file_header {};
+    std::vector<size_t> block_offsets;
+};
+
+// Compares the hops of two traces in order (centre, source, features and outputs), ignoring the block
+// layout and timing. Differences beyond tolerance are reported; returns whether there were none.
+bool compareTraces(const TraceReader& expected, const TraceReader& actual, float tolerance, std::ostream& report);
+
+#endif
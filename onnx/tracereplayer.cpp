@@ -0,0 +1,91 @@
+#include "tracereplayer.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+TraceReplayer::TraceReplayer(BeatNet& tracker):
+    tracker(tracker),
+    output(3)
+{
+    block_events.reserve(16);
+    activations.reserve(3 * MAX_BATCH_HOPS * 4);
+}
+
+long long TraceReplayer::replay(const TraceReader& trace, ReplayStage stage, bool realtime, TraceRecorder* recorder)
+{
+    if (stage == ReplayStage::Framer && !(trace.header().flags & TraceAudio)) {
+        std::cerr << "The trace has no audio to replay from the framer" << std::endl;
+        return -1;
+    }
+
+    // the recorded hops already say which of them were shed, a replay must not depend on its own timing
+    tracker.setLoadShedding(false);
+    tracker.setTraceRecorder(recorder);
+    processing_seconds = 0.0;
+    num_hops = 0;
+    num_events = 0;
+
+    double sample_rate = 0.0;
+    double stream_time = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    long long blocks = 0;
+    for (size_t index = 0; index < trace.numBlocks(); ++index) {
+        const TraceReader::Block block = trace.block(index);
+        const TraceBlock& info = *block.info;
+
+        if (info.sample_rate != sample_rate && info.sample_rate > 0.0) {
+            sample_rate = info.sample_rate;
+            tracker.setup(sample_rate, static_cast<int>(std::max<uint32_t>(info.num_frames, 1)));
+        }
+        if (realtime) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(stream_time)));
+        }
+
+        if (recorder) {
+            recorder->beginBlock(info.sample_rate, info.num_frames, static_cast<int>(info.num_channels));
+        }
+        activations.clear();
+        auto block_start = std::chrono::steady_clock::now();
+        switch (stage) {
+            case ReplayStage::Framer:
+                tracker.replaySamples(block.samples, static_cast<int>(info.num_samples), info.num_frames, output, block_events, activations);
+                break;
+            case ReplayStage::Model:
+            case ReplayStage::Events:
+                tracker.replayHops(block.hops, static_cast<int>(info.num_hops), stage == ReplayStage::Events, info.num_frames,
+                                   output, block_events, activations);
+                break;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - block_start).count();
+        if (recorder) {
+            recorder->endBlock(elapsed);
+        }
+
+        processing_seconds += elapsed;
+        num_hops += static_cast<long long>(activations.size() / 3);
+        num_events += static_cast<long long>(block_events.size());
+        if (sample_rate > 0.0) {
+            stream_time += info.num_frames / sample_rate;
+        }
+        blocks++;
+    }
+
+    tracker.setTraceRecorder(nullptr);
+    return blocks;
+}
+
+double TraceReplayer::processingSeconds() const
+{
+    return processing_seconds;
+}
+
+long long TraceReplayer::hops() const
+{
+    return num_hops;
+}
+
+long long TraceReplayer::events() const
+{
+    return num_events;
+}
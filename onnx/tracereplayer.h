@@ -0,0 +1,42 @@
+#ifndef TRACE_REPLAYER_H
+#define TRACE_REPLAYER_H
+
+#include <vector>
+#include "BeatNet.h"
+#include "tracefile.h"
+
+// Where a replay enters the tracker
+enum class ReplayStage {
+    Framer,     // the recorded resampled signal goes through framer, FFT, filterbank and model (needs TraceAudio)
+    Model,      // the recorded features go through the model
+    Events      // the recorded model outputs go to the beat detector and tempo estimator
+};
+
+// Feeds a trace back into a tracker block by block, at full speed or paced like the original stream.
+// Blocks keep their recorded boundaries and the hops their recorded source (gated, shed), so a replay
+// is deterministic: record it (without TraceTiming) and compare it to the original with compareTraces,
+// or replay twice and compare the files byte for byte.
+class TraceReplayer {
+public:
+    // tracker should be fresh; its energy gate setting matters for ReplayStage::Framer
+    explicit TraceReplayer(BeatNet& tracker);
+
+    // returns the number of blocks replayed, -1 if the trace does not support the stage
+    long long replay(const TraceReader& trace, ReplayStage stage, bool realtime = false, TraceRecorder* recorder = nullptr);
+
+    // of the last replay: time spent inside the tracker, hops and events produced
+    double processingSeconds() const;
+    long long hops() const;
+    long long events() const;
+
+private:
+    BeatNet& tracker;
+    std::vector<float> output;
+    std::vector<BeatEvent> block_events;
+    std::vector<float> activations;
+    double processing_seconds = 0.0;
+    long long num_hops = 0;
+    long long num_events = 0;
+};
+
+#endif